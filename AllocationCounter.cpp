@@ -0,0 +1,159 @@
+#include "AllocationCounter.h"
+
+#ifdef MS_ALLOCATION_STATS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined _WIN32
+#include <malloc.h>
+#endif
+
+static std::atomic<size_t> allocation_count(0);
+
+size_t GetAllocationCount()
+{
+	return allocation_count.load(std::memory_order_relaxed);
+}
+
+static void *Allocate(size_t size) noexcept
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+static void *AllocateAligned(size_t size, std::align_val_t alignment) noexcept
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+#if defined _WIN32
+	return _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+	void *ptr;
+
+	if (posix_memalign(&ptr, (size_t)alignment < sizeof(void *) ? sizeof(void *) : (size_t)alignment, size ? size : 1)) return nullptr;
+
+	return ptr;
+#endif
+}
+
+static void FreeAligned(void *ptr) noexcept
+{
+#if defined _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void *operator new(size_t size)
+{
+	if (void *ptr = Allocate(size)) return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	if (void *ptr = Allocate(size)) return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return Allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return Allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	if (void *ptr = AllocateAligned(size, alignment)) return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	if (void *ptr = AllocateAligned(size, alignment)) return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+	FreeAligned(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+	FreeAligned(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	FreeAligned(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	FreeAligned(ptr);
+}
+#else
+size_t GetAllocationCount()
+{
+	return 0;
+}
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap allocations are only counted in builds with MS_ALLOCATION_STATS defined, which replace the global operator new
+size_t GetAllocationCount();
@@ -0,0 +1,113 @@
+#include "Arena.h"
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+Arena::Arena(size_t block_size) : m_pos(nullptr), m_end(nullptr), m_block_size(block_size), m_size(0)
+{
+}
+
+Arena::Arena(Arena &&arena) noexcept : m_blocks(std::move(arena.m_blocks)), m_pos(arena.m_pos), m_end(arena.m_end), m_block_size(arena.m_block_size), m_size(arena.m_size)
+{
+	arena.m_blocks.clear();
+	arena.m_pos = arena.m_end = nullptr;
+	arena.m_size = 0;
+}
+
+Arena::~Arena()
+{
+	Clear();
+}
+
+void *Arena::Allocate(size_t size, size_t alignment)
+{
+	uintptr_t pos = ((uintptr_t)m_pos + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+	if (!m_pos || pos + size > (uintptr_t)m_end)
+	{
+		// Oversized requests get a block of their own so the current block keeps its free space
+		if (size + alignment > m_block_size / 4)
+		{
+			char *block = AllocateBlock(size + alignment);
+
+			m_size += size;
+			return (void *)(((uintptr_t)block + alignment - 1) & ~(uintptr_t)(alignment - 1));
+		}
+
+		m_pos = AllocateBlock(m_block_size);
+		m_end = m_pos + m_block_size;
+		pos = ((uintptr_t)m_pos + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	}
+
+	m_pos = (char *)(pos + size);
+	m_size += size;
+	return (void *)pos;
+}
+
+std::string_view Arena::Store(std::string_view str)
+{
+	if (str.empty()) return std::string_view();
+
+	char *data = Allocate<char>(str.size());
+
+	memcpy(data, str.data(), str.size());
+	return std::string_view(data, str.size());
+}
+
+void Arena::Clear()
+{
+	for (char *block : m_blocks) delete[] block;
+
+	m_blocks.clear();
+	m_pos = m_end = nullptr;
+	m_size = 0;
+}
+
+// Rewinds to the start of the current block and releases the others, so a short-lived arena keeps its memory between uses
+void Arena::Reset()
+{
+	char *block = m_pos ? m_end - m_block_size : nullptr;
+
+	for (char *it : m_blocks)
+	{
+		if (it != block) delete[] it;
+	}
+
+	m_blocks.clear();
+
+	if (block) m_blocks.push_back(block);
+
+	m_pos = block;
+	m_size = 0;
+}
+
+size_t Arena::GetSize() const
+{
+	return m_size;
+}
+
+Arena &Arena::operator =(Arena &&arena) noexcept
+{
+	if (this != &arena)
+	{
+		Clear();
+		m_blocks = std::move(arena.m_blocks);
+		m_pos = arena.m_pos;
+		m_end = arena.m_end;
+		m_block_size = arena.m_block_size;
+		m_size = arena.m_size;
+		arena.m_blocks.clear();
+		arena.m_pos = arena.m_end = nullptr;
+		arena.m_size = 0;
+	}
+
+	return *this;
+}
+
+char *Arena::AllocateBlock(size_t size)
+{
+	char *block = new char[size];
+
+	m_blocks.push_back(block);
+	return block;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+class Arena
+{
+public:
+	explicit Arena(size_t block_size = 1 << 20);
+	Arena(Arena &&arena) noexcept;
+	Arena(const Arena &) = delete;
+	~Arena();
+	void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	std::string_view Store(std::string_view str);
+	void Clear();
+	void Reset();
+	size_t GetSize() const;
+	Arena &operator =(Arena &&arena) noexcept;
+	Arena &operator =(const Arena &) = delete;
+
+	template <typename T> T *Allocate(size_t count = 1)
+	{
+		return static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+private:
+	char *AllocateBlock(size_t size);
+
+	std::vector<char *> m_blocks;
+	char *m_pos;
+	char *m_end;
+	size_t m_block_size;
+	size_t m_size;
+};
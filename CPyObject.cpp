@@ -1,4 +1,5 @@
 #include "CPyObject.h"
+#include <ostream>
 
 CPyObject::CPyObject() : m_obj(nullptr)
 {
@@ -49,7 +50,31 @@ bool CPyObject::DelAttr(const CPyString &name)
 
 const CPyObject CPyObject::GetItem(ssize_t pos) const
 {
-	return CheckObj(PyObject_GetItem(m_obj, CheckObj(PyLong_FromSsize_t(pos))));
+	PyObject *item_obj = GetBorrowedItem(pos);
+
+	if (item_obj)
+	{
+		Py_INCREF(item_obj);
+		return item_obj;
+	}
+
+	CPyObject index(CheckObj(PyLong_FromSsize_t(pos)));
+
+	return CheckObj(PyObject_GetItem(m_obj, index.m_obj));
+}
+
+PyObject *CPyObject::GetBorrowedItem(ssize_t pos) const
+{
+	if (PyTuple_Check(m_obj))
+	{
+		if (pos >= 0 && pos < PyTuple_GET_SIZE(m_obj)) return PyTuple_GET_ITEM(m_obj, pos);
+	}
+	else if (PyList_Check(m_obj))
+	{
+		if (pos >= 0 && pos < PyList_GET_SIZE(m_obj)) return PyList_GET_ITEM(m_obj, pos);
+	}
+
+	return nullptr;
 }
 
 ssize_t CPyObject::Len() const
@@ -84,6 +109,11 @@ CPyList CPyObject::AsList() const
 	return m_obj;
 }
 
+CPySequence CPyObject::AsSequence() const
+{
+	return CheckObj(PySequence_Fast(m_obj, "not a sequence"));
+}
+
 CPyString CPyObject::AsString() const
 {
 	Py_XINCREF(m_obj);
@@ -202,7 +232,43 @@ CPyObject::operator CPyNumber() const
 
 std::ostream &operator <<(std::ostream &stream, const CPyObject &cobj)
 {
-	return stream << (std::string)cobj.Str();
+	PyObject *obj = cobj.m_obj;
+
+	if (PyLong_CheckExact(obj))
+	{
+#if PY_VERSION_HEX >= 0x030C0000
+		if (PyUnstable_Long_IsCompact((PyLongObject *)obj)) return stream << (long long)PyUnstable_Long_CompactValue((PyLongObject *)obj);
+#endif
+		int overflow;
+		long long val = PyLong_AsLongLongAndOverflow(obj, &overflow);
+
+		if (overflow == 0 && (val != -1 || !PyErr_Occurred())) return stream << val;
+		if (overflow > 0)
+		{
+			unsigned long long uval = PyLong_AsUnsignedLongLong(obj);
+
+			if (uval != (unsigned long long)-1 || !PyErr_Occurred()) return stream << uval;
+		}
+
+		PyErr_Clear();
+	}
+	else if (PyFloat_CheckExact(obj))
+	{
+		char *buffer = PyOS_double_to_string(PyFloat_AS_DOUBLE(obj), 'r', 0, Py_DTSF_ADD_DOT_0, nullptr);
+
+		if (buffer)
+		{
+			stream << buffer;
+			PyMem_Free(buffer);
+			return stream;
+		}
+
+		cobj.CheckErr();
+	}
+	else if (PyUnicode_CheckExact(obj))
+		return stream << CPyString(cobj).View();
+
+	return stream << cobj.Str().View();
 }
 
 int CPyObject::Check2(int val) const
@@ -225,15 +291,30 @@ PyObject *CPyObject::CheckObj(PyObject *obj) const
 
 void CPyObject::CheckErr() const
 {
-	PyObject *err_obj = PyErr_Occurred();
+	PyObject *type, *value, *traceback;
+
+	if (!PyErr_Occurred()) return;
 
-	if (err_obj)
+	PyErr_Fetch(&type, &value, &traceback);
+	PyErr_NormalizeException(&type, &value, &traceback);
+	Py_XINCREF(type);
+	Py_XINCREF(value);
+	PyErr_Restore(type, value, traceback);
+	PyErr_Print(); // TODO: STFU
+	PyErr_Clear();
+
+	CPyObject type_obj(type);
+	CPyObject value_obj(value);
+	std::string text(reinterpret_cast<PyTypeObject *>(type)->tp_name);
+
+	if (value)
 	{
-		Py_XINCREF(err_obj);
-		PyErr_Print(); // TODO: STFU
-		PyErr_Clear();
-		throw CPyException(CPyObject(err_obj).Str());
+		CPyString str = value_obj.Str();
+
+		if (!str.View().empty()) text.append(": ").append(str.View());
 	}
+
+	throw CPyException(text);
 }
 
 void CPyObject::SetObject(PyObject *obj)
@@ -288,7 +369,10 @@ CPyModule::CPyModule(PyObject *obj) : CPyObject(obj)
 
 void CPyModule::Reload()
 {
-	m_obj = CheckObj(PyImport_ReloadModule(m_obj));
+	PyObject *module_obj = CheckObj(PyImport_ReloadModule(m_obj));
+
+	Py_DECREF(m_obj);
+	m_obj = module_obj;
 }
 
 CPyIter::CPyIter(PyObject *obj) : CPyObject(obj)
@@ -332,12 +416,19 @@ CPyObject CPyTuple::GetSlice(ssize_t low, ssize_t high) const
 
 CPyObject CPyTuple::GetItem(ssize_t pos) const
 {
-	PyObject *item_obj = CheckObj(PyTuple_GetItem(m_obj, pos));
+	PyObject *item_obj = GetBorrowedItem(pos);
 
 	Py_XINCREF(item_obj);
 	return item_obj;
 }
 
+PyObject *CPyTuple::GetBorrowedItem(ssize_t pos) const
+{
+	if (pos < 0 || pos >= PyTuple_GET_SIZE(m_obj)) return CheckObj(PyTuple_GetItem(m_obj, pos));
+
+	return PyTuple_GET_ITEM(m_obj, pos);
+}
+
 bool CPyTuple::SetItem(ssize_t pos, const CPyObject& cobj)
 {
 	PyObject *item_obj = cobj.GetRawObject();
@@ -378,12 +469,19 @@ CPyObject CPyList::GetSlice(ssize_t low, ssize_t high) const
 
 CPyObject CPyList::GetItem(ssize_t pos) const
 {
-	PyObject *item_obj = CheckObj(PyList_GetItem(m_obj, pos));
+	PyObject *item_obj = GetBorrowedItem(pos);
 
 	Py_XINCREF(item_obj);
 	return item_obj;
 }
 
+PyObject *CPyList::GetBorrowedItem(ssize_t pos) const
+{
+	if (pos < 0 || pos >= PyList_GET_SIZE(m_obj)) return CheckObj(PyList_GetItem(m_obj, pos));
+
+	return PyList_GET_ITEM(m_obj, pos);
+}
+
 bool CPyList::SetItem(ssize_t pos, const CPyObject& cobj)
 {
 	PyObject *item_obj = cobj.GetRawObject();
@@ -397,6 +495,40 @@ ssize_t CPyList::Size() const
 	return PyList_Size(m_obj);
 }
 
+CPySequence::CPySequence(PyObject *obj) : CPyObject(obj)
+{
+	if (!IsTuple() && !IsList()) throw CPyException("not a sequence");
+}
+
+CPyObject CPySequence::GetItem(ssize_t pos) const
+{
+	PyObject *item_obj = GetBorrowedItem(pos);
+
+	Py_XINCREF(item_obj);
+	return item_obj;
+}
+
+PyObject *CPySequence::GetBorrowedItem(ssize_t pos) const
+{
+	if (pos < 0 || pos >= PySequence_Fast_GET_SIZE(m_obj))
+	{
+		PyErr_SetString(PyExc_IndexError, "sequence index out of range");
+		CheckErr();
+	}
+
+	return PySequence_Fast_GET_ITEM(m_obj, pos);
+}
+
+ssize_t CPySequence::Size() const
+{
+	return PySequence_Fast_GET_SIZE(m_obj);
+}
+
+const CPyObject CPySequence::operator [](ssize_t pos) const
+{
+	return GetItem(pos);
+}
+
 CPyString::CPyString()
 {
 	m_obj = CheckObj(PyUnicode_FromString(""));
@@ -417,13 +549,35 @@ CPyString::CPyString(PyObject *obj) : CPyObject(obj)
 	if (!IsString()) throw CPyException("not a string");
 }
 
-CPyString::operator std::string() const
+// The view points into the string object (or its cached UTF-8 copy) and is valid while the object is alive
+std::string_view CPyString::View() const
 {
-	PyObject *bytes_obj = CheckObj(PyUnicode_AsUTF8String(m_obj));
+#if PY_VERSION_HEX < 0x030C0000
+	if (PyUnicode_READY(m_obj) == -1) CheckErr();
+#endif
 
-	if (!bytes_obj) return "";
+	if (PyUnicode_IS_COMPACT_ASCII(m_obj)) return std::string_view((const char *)PyUnicode_DATA(m_obj), PyUnicode_GET_LENGTH(m_obj));
 
-	return PyBytes_AsString(bytes_obj);
+	Py_ssize_t size;
+	const char *data = PyUnicode_AsUTF8AndSize(m_obj, &size);
+
+	if (!data)
+	{
+		CheckErr();
+		return std::string_view();
+	}
+
+	return std::string_view(data, size);
+}
+
+CPyString::operator std::string() const
+{
+	return std::string(View());
+}
+
+CPyString::operator std::string_view() const
+{
+	return View();
 }
 
 CPyLong::CPyLong()
@@ -504,10 +658,37 @@ CPyNumber::CPyNumber(PyObject *obj) : CPyObject(obj)
 
 CPyNumber CPyNumber::operator >>(int shift) const
 {
-	return PyNumber_Rshift(m_obj, CheckObj(PyLong_FromLong(shift)));
+	CPyObject shift_obj(CheckObj(PyLong_FromLong(shift)));
+
+	return CheckObj(PyNumber_Rshift(m_obj, shift_obj.GetRawObject()));
 }
 
 CPyNumber::operator unsigned long long() const
 {
-	return CPyLong(PyLong_AsUnsignedLongLongMask(PyNumber_Long(m_obj)));
+	if (PyLong_Check(m_obj)) return PyLong_AsUnsignedLongLongMask(m_obj);
+
+	CPyObject long_obj(CheckObj(PyNumber_Long(m_obj)));
+
+	return PyLong_AsUnsignedLongLongMask(long_obj.GetRawObject());
+}
+
+CPyNumber::operator WideInt() const
+{
+	unsigned char bytes[WideInt::NUM_BITS / 8 + 1];
+	CPyObject long_obj(CheckObj(PyNumber_Index(m_obj)));
+
+#if PY_VERSION_HEX >= 0x030D0000
+	Py_ssize_t size = PyLong_AsNativeBytes(long_obj.GetRawObject(), bytes, sizeof(bytes), Py_ASNATIVEBYTES_LITTLE_ENDIAN);
+
+	if (size < 0) CheckErr();
+	if (size > (Py_ssize_t)sizeof(bytes)) throw CPyException("integer too wide");
+#else
+	if (_PyLong_AsByteArray((PyLongObject *)long_obj.GetRawObject(), bytes, sizeof(bytes), 1, 1) == -1) CheckErr();
+#endif
+
+	unsigned char sign = bytes[sizeof(bytes) - 1];
+
+	if (sign != 0 && (sign != 0xFF || !(bytes[sizeof(bytes) - 2] & 0x80))) throw CPyException("integer too wide");
+
+	return WideInt(bytes, sizeof(bytes));
 }
@@ -1,9 +1,14 @@
+#pragma once
+
 #include "Python.h"
 #include <string>
+#include <string_view>
+#include "WideInt.h"
 
 class CPyIter;
 class CPyTuple;
 class CPyList;
+class CPySequence;
 class CPyString;
 class CPyLong;
 class CPyFloat;
@@ -22,12 +27,14 @@ public:
 	bool SetAttr(const CPyString &name, const CPyObject &value);
 	bool DelAttr(const CPyString &name);
 	const CPyObject GetItem(ssize_t pos) const;
+	PyObject *GetBorrowedItem(ssize_t pos) const;
 	ssize_t Len() const;
 	CPyString Str() const;
 	CPyObject Type() const;
 	CPyIter GetIter() const;
 	CPyTuple AsTuple() const;
 	CPyList AsList() const;
+	CPySequence AsSequence() const;
 	CPyString AsString() const;
 	CPyLong AsLong() const;
 	CPyFloat AsFloat() const;
@@ -101,6 +108,7 @@ public:
 	CPyTuple(PyObject *obj);
 	CPyObject GetSlice(ssize_t low, ssize_t high) const;
 	CPyObject GetItem(ssize_t pos) const;
+	PyObject *GetBorrowedItem(ssize_t pos) const;
 	bool SetItem(ssize_t pos, const CPyObject& cobj);
 	ssize_t Size() const;
 };
@@ -114,10 +122,21 @@ public:
 	void Append(const CPyObject& cobj);
 	CPyObject GetSlice(ssize_t low, ssize_t high) const;
 	CPyObject GetItem(ssize_t pos) const;
+	PyObject *GetBorrowedItem(ssize_t pos) const;
 	bool SetItem(ssize_t pos, const CPyObject& cobj);
 	ssize_t Size() const;
 };
 
+class CPySequence : public CPyObject
+{
+public:
+	CPySequence(PyObject *obj);
+	CPyObject GetItem(ssize_t pos) const;
+	PyObject *GetBorrowedItem(ssize_t pos) const;
+	ssize_t Size() const;
+	const CPyObject operator [](ssize_t pos) const;
+};
+
 class CPyString : public CPyObject
 {
 public:
@@ -125,7 +144,9 @@ public:
 	CPyString(const char *str);
 	CPyString(const std::string &str);
 	CPyString(PyObject *obj);
+	std::string_view View() const;
 	operator std::string() const;
+	operator std::string_view() const;
 };
 
 class CPyLong : public CPyObject
@@ -158,4 +179,5 @@ public:
 	CPyNumber(PyObject *obj);
 	CPyNumber operator >>(int shift) const;
 	operator unsigned long long() const;
+	operator WideInt() const;
 };
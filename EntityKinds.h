@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string_view>
+
+// Kinds with an identifier prefix come first, so their index doubles as the symbol table prefix index
+enum EntityKind
+{
+	EK_ANIMATION,
+	EK_FACTION,
+	EK_GAME_MENU,
+	EK_INFO_PAGE,
+	EK_ITEM,
+	EK_MAP_ICON,
+	EK_MESH,
+	EK_MUSIC,
+	EK_MISSION_TEMPLATE,
+	EK_PARTICLE_SYSTEM,
+	EK_PARTY,
+	EK_PARTY_TEMPLATE,
+	EK_POSTFX,
+	EK_PRESENTATION,
+	EK_QUEST,
+	EK_SCENE_PROP,
+	EK_SCENE,
+	EK_SCRIPT,
+	EK_SKILL,
+	EK_SOUND,
+	EK_STRING,
+	EK_TABLEAU,
+	EK_TROOP,
+	EK_DIALOG,
+	EK_SIMPLE_TRIGGER,
+	EK_SKIN,
+	EK_TRIGGER,
+	EK_FLORA_KIND,
+	EK_SKYBOX,
+	EK_GROUND_SPEC,
+	NUM_ENTITY_KINDS
+};
+
+struct EntityKindInfo
+{
+	std::string_view module_name;
+	std::string_view list_name;
+	std::string_view prefix;
+	std::string_view id_name;
+	std::string_view id_prefix;
+	int tag;
+};
+
+constexpr EntityKindInfo entity_kinds[NUM_ENTITY_KINDS] =
+{
+	{ "animations", "animations", "anim", "animations", "anim", 25 },
+	{ "factions", "factions", "fac", "factions", "fac", 6 },
+	{ "game_menus", "game_menus", "mnu", "menus", "menu", 12 },
+	{ "info_pages", "info_pages", "ip", "info_pages", "ip", 0 },
+	{ "items", "items", "itm", "items", "itm", 4 },
+	{ "map_icons", "map_icons", "icon", "map_icons", "icon", 18 },
+	{ "meshes", "meshes", "mesh", "meshes", "mesh", 20 },
+	{ "music", "tracks", "track", "music", "track", 23 },
+	{ "mission_templates", "mission_templates", "mt", "mission_templates", "mst", 11 },
+	{ "particle_systems", "particle_systems", "psys", "particle_systems", "psys", 14 },
+	{ "parties", "parties", "p", "parties", "p", 9 },
+	{ "party_templates", "party_templates", "pt", "party_templates", "pt", 8 },
+	{ "postfx", "postfx_params", "pfx", "postfx_params", "pfx", 0 },
+	{ "presentations", "presentations", "prsnt", "presentations", "prsnt", 21 },
+	{ "quests", "quests", "qst", "quests", "qst", 7 },
+	{ "scene_props", "scene_props", "spr", "scene_props", "spr", 15 },
+	{ "scenes", "scenes", "scn", "scenes", "scn", 10 },
+	{ "scripts", "scripts", "script", "scripts", "script", 13 },
+	{ "skills", "skills", "skl", "skills", "skl", 19 },
+	{ "sounds", "sounds", "snd", "sounds", "snd", 16 },
+	{ "strings", "strings", "str", "strings", "str", 3 },
+	{ "tableau_materials", "tableaus", "tableau", "tableau_materials", "tableau", 24 },
+	{ "troops", "troops", "trp", "troops", "trp", 5 },
+	{ "dialogs", "dialogs", "", "", "", 0 },
+	{ "simple_triggers", "simple_triggers", "", "", "", 0 },
+	{ "skins", "skins", "", "", "", 0 },
+	{ "triggers", "triggers", "", "", "", 0 },
+	{ "flora_kinds", "fauna_kinds", "", "", "", 0 },
+	{ "skyboxes", "skyboxes", "", "", "", 0 },
+	{ "ground_specs", "ground_specs", "", "", "", 0 },
+};
+
+constexpr std::string_view engine_script_prefixes[] = { "game_", "wse_" };
+constexpr std::string_view can_fail_script_prefix = "cf_";
+
+constexpr bool has_prefix(std::string_view name, std::string_view prefix)
+{
+	return name.substr(0, prefix.length()) == prefix;
+}
+
+constexpr bool is_engine_script(std::string_view name)
+{
+	for (std::string_view prefix : engine_script_prefixes)
+	{
+		if (has_prefix(name, prefix)) return true;
+	}
+
+	return false;
+}
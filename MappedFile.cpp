@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+#if defined _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined _WIN32
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#else
+MappedFile::MappedFile() : m_data(nullptr), m_size(0)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// Empty files open successfully with no data, since neither platform can map zero bytes
+bool MappedFile::Open(const std::string &path)
+{
+	Close();
+#if defined _WIN32
+	LARGE_INTEGER size;
+
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (m_file == INVALID_HANDLE_VALUE) return false;
+
+	if (!GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		return false;
+	}
+
+	if (size.QuadPart == 0) return true;
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (m_mapping) m_data = (const char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = (size_t)size.QuadPart;
+#else
+	struct stat info;
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if (fd < 0) return false;
+
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+
+	if (info.st_size > 0)
+	{
+		void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data == MAP_FAILED)
+		{
+			close(fd);
+			return false;
+		}
+
+		m_data = (const char *)data;
+		m_size = (size_t)info.st_size;
+	}
+
+	close(fd);
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#if defined _WIN32
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = nullptr;
+#else
+	if (m_data) munmap((void *)m_data, m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+std::string_view MappedFile::GetData() const
+{
+	return std::string_view(m_data, m_size);
+}
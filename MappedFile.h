@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	~MappedFile();
+	bool Open(const std::string &path);
+	void Close();
+	std::string_view GetData() const;
+	MappedFile &operator =(const MappedFile &) = delete;
+
+private:
+	const char *m_data;
+	size_t m_size;
+#if defined _WIN32
+	void *m_file;
+	void *m_mapping;
+#endif
+};
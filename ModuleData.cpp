@@ -0,0 +1,357 @@
+#include "ModuleData.h"
+#include <new>
+#include <utility>
+#include "StringUtils.h"
+
+DataNode::DataNode() : m_type(NT_NONE), m_flags(0), m_size(0), m_int(0)
+{
+}
+
+int DataNode::GetType() const
+{
+	return m_type;
+}
+
+bool DataNode::IsNone() const
+{
+	return m_type == NT_NONE;
+}
+
+bool DataNode::IsTuple() const
+{
+	return (m_flags & NF_TUPLE) != 0;
+}
+
+bool DataNode::IsList() const
+{
+	return (m_flags & NF_LIST) != 0;
+}
+
+bool DataNode::IsSequence() const
+{
+	return m_type == NT_SEQUENCE;
+}
+
+bool DataNode::IsString() const
+{
+	return m_type == NT_STRING;
+}
+
+bool DataNode::IsLong() const
+{
+	return m_type == NT_INT || m_type == NT_WIDE_INT;
+}
+
+bool DataNode::IsFloat() const
+{
+	return m_type == NT_FLOAT;
+}
+
+ptrdiff_t DataNode::Len() const
+{
+	if (m_type != NT_STRING) CheckSequence();
+
+	return m_size;
+}
+
+const DataNode *DataNode::begin() const
+{
+	CheckSequence();
+	return m_items;
+}
+
+const DataNode *DataNode::end() const
+{
+	CheckSequence();
+	return m_items + m_size;
+}
+
+long long DataNode::AsLong() const
+{
+	if (m_type == NT_INT) return m_int;
+	if (m_type == NT_WIDE_INT) return (long long)m_wide->value.Low();
+
+	throw CompileException("expected an integer, got " + Str());
+}
+
+double DataNode::AsFloat() const
+{
+	if (m_type == NT_FLOAT) return m_float;
+	if (m_type == NT_INT) return (double)m_int;
+	if (m_type == NT_WIDE_INT) return std::stod(Str());
+
+	throw CompileException("expected a float, got " + Str());
+}
+
+WideInt DataNode::AsNumber() const
+{
+	if (m_type == NT_INT) return WideInt(m_int);
+	if (m_type == NT_WIDE_INT) return m_wide->value;
+	if (m_type == NT_FLOAT) return WideInt((long long)m_float);
+
+	throw CompileException("expected a number, got " + Str());
+}
+
+std::string_view DataNode::AsString() const
+{
+	if (m_type == NT_STRING) return std::string_view(m_str, m_size);
+
+	throw CompileException("expected a string, got " + Str());
+}
+
+std::string DataNode::Str() const
+{
+	switch (m_type)
+	{
+	case NT_NONE:
+		return "None";
+	case NT_INT:
+		if (m_flags & NF_BOOL) return m_int ? "True" : "False";
+		return std::to_string(m_int);
+	case NT_WIDE_INT:
+		return m_wide->text.empty() ? m_wide->value.ToString() : std::string(m_wide->text);
+	case NT_FLOAT:
+		return ftostr(m_float);
+	case NT_STRING:
+		return std::string(m_str, m_size);
+	case NT_SEQUENCE:
+	{
+		std::string text(1, IsList() ? '[' : '(');
+
+		for (unsigned int i = 0; i < m_size; ++i)
+		{
+			if (i) text += ", ";
+
+			if (m_items[i].IsString())
+				text += "'" + m_items[i].Str() + "'";
+			else
+				text += m_items[i].Str();
+		}
+
+		if (m_size == 1 && !IsList()) text += ',';
+
+		text += IsList() ? ']' : ')';
+		return text;
+	}
+	default:
+		return std::string(m_other->text);
+	}
+}
+
+std::string_view DataNode::TypeName() const
+{
+	switch (m_type)
+	{
+	case NT_NONE:
+		return "<class 'NoneType'>";
+	case NT_INT:
+		return m_flags & NF_BOOL ? "<class 'bool'>" : "<class 'int'>";
+	case NT_WIDE_INT:
+		return "<class 'int'>";
+	case NT_FLOAT:
+		return "<class 'float'>";
+	case NT_STRING:
+		return "<class 'str'>";
+	case NT_SEQUENCE:
+		return IsList() ? "<class 'list'>" : "<class 'tuple'>";
+	default:
+		return m_other->type_name;
+	}
+}
+
+const DataNode &DataNode::operator [](ptrdiff_t pos) const
+{
+	CheckSequence();
+
+	if (pos < 0 || pos >= (ptrdiff_t)m_size) throw CompileException((IsList() ? "list index out of range in " : "tuple index out of range in ") + Str());
+
+	return m_items[pos];
+}
+
+std::ostream &operator <<(std::ostream &stream, const DataNode &node)
+{
+	switch (node.m_type)
+	{
+	case NT_INT:
+		if (node.m_flags & NF_BOOL) return stream << (node.m_int ? "True" : "False");
+		return stream << node.m_int;
+	case NT_WIDE_INT:
+		if (node.m_wide->text.empty()) return stream << node.m_wide->value;
+		return stream << node.m_wide->text;
+	case NT_FLOAT:
+		return stream << ftostr(node.m_float);
+	case NT_STRING:
+		return stream << std::string_view(node.m_str, node.m_size);
+	default:
+		return stream << node.Str();
+	}
+}
+
+OutputBuffer &operator <<(OutputBuffer &stream, const DataNode &node)
+{
+	switch (node.m_type)
+	{
+	case NT_INT:
+		if (node.m_flags & NF_BOOL) return stream << (node.m_int ? "True" : "False");
+		return stream << node.m_int;
+	case NT_WIDE_INT:
+		if (node.m_wide->text.empty()) return stream << node.m_wide->value;
+		return stream << node.m_wide->text;
+	case NT_FLOAT:
+		return stream << node.m_float;
+	case NT_STRING:
+		return stream << std::string_view(node.m_str, node.m_size);
+	default:
+		return stream << node.Str();
+	}
+}
+
+void DataNode::CheckSequence() const
+{
+	if (m_type != NT_SEQUENCE) throw CompileException("expected a tuple or list, got " + Str());
+}
+
+DataSnapshot::DataSnapshot()
+{
+}
+
+DataSnapshot::~DataSnapshot()
+{
+	ReleaseSources();
+}
+
+// Converts a module list into a tree of native nodes; the source object is kept alive until ReleaseSources so string identities stay valid
+DataNode DataSnapshot::Import(const CPyObject &obj)
+{
+	DataNode node;
+
+	m_sources.push_back(obj);
+	Convert(obj.GetRawObject(), node);
+	return node;
+}
+
+void DataSnapshot::ReleaseSources()
+{
+	m_sources.clear();
+	m_strings.clear();
+}
+
+// Takes over the memory of a snapshot built on another thread; its nodes stay valid as part of this snapshot
+void DataSnapshot::Adopt(DataSnapshot &snapshot)
+{
+	snapshot.ReleaseSources();
+	m_adopted.push_back(std::move(snapshot.m_arena));
+
+	for (auto &arena : snapshot.m_adopted) m_adopted.push_back(std::move(arena));
+
+	snapshot.m_adopted.clear();
+}
+
+void DataSnapshot::Clear()
+{
+	ReleaseSources();
+	m_arena.Clear();
+	m_adopted.clear();
+}
+
+size_t DataSnapshot::GetSize() const
+{
+	size_t size = m_arena.GetSize();
+
+	for (auto &arena : m_adopted) size += arena.GetSize();
+
+	return size;
+}
+
+void DataSnapshot::Convert(PyObject *obj, DataNode &node)
+{
+	if (PyUnicode_Check(obj))
+	{
+		std::string_view str = StoreString(obj);
+
+		node.m_type = NT_STRING;
+		node.m_size = (unsigned int)str.size();
+		node.m_str = str.data();
+	}
+	else if (PyLong_Check(obj))
+	{
+		int overflow;
+		long long val = PyLong_AsLongLongAndOverflow(obj, &overflow);
+
+		if (PyBool_Check(obj)) node.m_flags |= NF_BOOL;
+
+		if (!overflow)
+		{
+			node.m_type = NT_INT;
+			node.m_int = val;
+		}
+		else
+		{
+			WideValue *wide = new (m_arena.Allocate<WideValue>()) WideValue();
+			size_t num_bits = _PyLong_NumBits(obj);
+
+			Py_INCREF(obj);
+			CPyNumber number(obj);
+
+			if (num_bits < WideInt::NUM_BITS || (num_bits == WideInt::NUM_BITS && overflow > 0))
+				wide->value = number;
+			else
+			{
+				CPyNumber one(1);
+				CPyNumber mask(PyNumber_Subtract(CPyNumber(PyNumber_Lshift(one.GetRawObject(), CPyNumber(WideInt::NUM_BITS).GetRawObject())).GetRawObject(), one.GetRawObject()));
+
+				wide->value = CPyNumber(PyNumber_And(obj, mask.GetRawObject()));
+				wide->text = m_arena.Store(number.Str().View());
+			}
+
+			node.m_type = NT_WIDE_INT;
+			node.m_wide = wide;
+		}
+	}
+	else if (PyFloat_Check(obj))
+	{
+		node.m_type = NT_FLOAT;
+		node.m_float = PyFloat_AS_DOUBLE(obj);
+	}
+	else if (PyTuple_Check(obj) || PyList_Check(obj))
+	{
+		Py_ssize_t size = PySequence_Fast_GET_SIZE(obj);
+		PyObject **items = PySequence_Fast_ITEMS(obj);
+		DataNode *children = m_arena.Allocate<DataNode>(size);
+
+		for (Py_ssize_t i = 0; i < size; ++i) Convert(items[i], *new (&children[i]) DataNode());
+
+		node.m_type = NT_SEQUENCE;
+		node.m_flags = PyList_Check(obj) ? NF_LIST : NF_TUPLE;
+		node.m_size = (unsigned int)size;
+		node.m_items = children;
+	}
+	else if (obj == Py_None)
+		node.m_type = NT_NONE;
+	else
+	{
+		OtherValue *other = new (m_arena.Allocate<OtherValue>()) OtherValue();
+
+		Py_INCREF(obj);
+		CPyObject cobj(obj);
+
+		other->type_name = m_arena.Store(cobj.Type().Str().View());
+		other->text = m_arena.Store(cobj.Str().View());
+
+		node.m_type = NT_OTHER;
+		node.m_other = other;
+	}
+}
+
+std::string_view DataSnapshot::StoreString(PyObject *obj)
+{
+	auto it = m_strings.find(obj);
+
+	if (it != m_strings.end()) return it->second;
+
+	Py_INCREF(obj);
+	std::string_view str = m_arena.Store(CPyString(obj).View());
+
+	m_strings.insert({ obj, str });
+	return str;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Arena.h"
+#include "CPyObject.h"
+#include "OutputBuffer.h"
+#include "WideInt.h"
+
+#define NT_NONE     0
+#define NT_INT      1
+#define NT_WIDE_INT 2
+#define NT_FLOAT    3
+#define NT_STRING   4
+#define NT_SEQUENCE 5
+#define NT_OTHER    6
+
+#define NF_TUPLE 0x1
+#define NF_LIST  0x2
+#define NF_BOOL  0x4
+
+class CompileException
+{
+public:
+	explicit CompileException(const std::string &error) : m_error(error) { }
+
+	const std::string &GetText() const
+	{
+		return m_error;
+	}
+
+private:
+	std::string m_error;
+};
+
+struct WideValue
+{
+	WideInt value;
+	std::string_view text;
+};
+
+struct OtherValue
+{
+	std::string_view type_name;
+	std::string_view text;
+};
+
+class DataNode
+{
+public:
+	DataNode();
+	int GetType() const;
+	bool IsNone() const;
+	bool IsTuple() const;
+	bool IsList() const;
+	bool IsSequence() const;
+	bool IsString() const;
+	bool IsLong() const;
+	bool IsFloat() const;
+	ptrdiff_t Len() const;
+	const DataNode *begin() const;
+	const DataNode *end() const;
+	long long AsLong() const;
+	double AsFloat() const;
+	WideInt AsNumber() const;
+	std::string_view AsString() const;
+	std::string Str() const;
+	std::string_view TypeName() const;
+	const DataNode &operator [](ptrdiff_t pos) const;
+	friend std::ostream &operator <<(std::ostream &stream, const DataNode &node);
+	friend OutputBuffer &operator <<(OutputBuffer &stream, const DataNode &node);
+
+private:
+	friend class DataSnapshot;
+	void CheckSequence() const;
+
+	unsigned char m_type;
+	unsigned char m_flags;
+	unsigned int m_size;
+	union
+	{
+		long long m_int;
+		const char *m_str;
+		const DataNode *m_items;
+		const WideValue *m_wide;
+		double m_float;
+		const OtherValue *m_other;
+	};
+};
+
+class DataSnapshot
+{
+public:
+	DataSnapshot();
+	~DataSnapshot();
+	DataNode Import(const CPyObject &obj);
+	void ReleaseSources();
+	void Adopt(DataSnapshot &snapshot);
+	void Clear();
+	size_t GetSize() const;
+
+private:
+	void Convert(PyObject *obj, DataNode &node);
+	std::string_view StoreString(PyObject *obj);
+
+	Arena m_arena;
+	std::vector<Arena> m_adopted;
+	std::vector<CPyObject> m_sources;
+	std::unordered_map<PyObject *, std::string_view> m_strings;
+};
@@ -1,78 +1,140 @@
 #include "ModuleSystem.h"
 
-std::string encode_str(const std::string &str)
+ModuleSystem::ModuleSystem(const std::string &in_path, const std::string &out_path) : m_input_path(in_path), m_output_path(out_path), m_collect_modules(false), m_local_vars(NUM_LOCAL_VAR_SLOTS), m_local_var_slots(NUM_LOCAL_VAR_SLOTS), m_num_local_vars(0), m_local_var_generation(0), m_local_vars_exceeded(false), m_local_var_names(1 << 12), m_operand_cache(1 << 12, CachedOperand()), m_num_cached_operands(0), m_cur_location(std::string_view()), m_builtin_import(nullptr), m_num_statements(0), m_write_allocations(0)
 {
-	std::string text = str;
-	return replace(replace(text, ' ', '_'), '\t', '_');
+#if defined _WIN32
+	m_console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+	GetConsoleScreenBufferInfo(m_console_handle, &m_console_info);
+#endif
+
+	for (const EntityKindInfo &info : entity_kinds)
+	{
+		if (!info.prefix.empty()) m_symbols.AddPrefix(info.prefix, false);
+	}
 }
 
-std::string encode_res(const std::string &str)
+ModuleSystem::~ModuleSystem()
 {
-	std::string text = str;
-	return replace(replace(trim(text), ' ', '_'), '\t', '_');
+	//UnloadPythonInterpreter();
 }
 
-std::string encode_full(const std::string &str)
+void ModuleSystem::SetCachePath(const std::string &cache_path)
 {
-	std::string text = encode_str(str);
-	std::string result;
+	m_cache_path = cache_path;
+}
 
-	for (size_t i = 0; i < text.size(); ++i)
+void ModuleSystem::LoadPythonInterpreter()
+{
+	if (m_flags & MSF_ISOLATED_PYTHON)
 	{
-		char c = text[i];
-		switch (c)
-		{
-		case ',':
-		case '|':
-			break;
-		case '\'':
-		case '`':
-		case '(':
-		case ')':
-		case '-':
-			result.push_back('_');
-			break;
-		default:
-			result.push_back(c);
-			break;
-		}
+#if PY_VERSION_HEX >= 0x03080000
+		PyConfig config;
+
+		PyConfig_InitIsolatedConfig(&config);
+		config.site_import = 0;
+
+		PyStatus status = Py_InitializeFromConfig(&config);
+
+		PyConfig_Clear(&config);
+
+		if (PyStatus_Exception(status)) Py_ExitStatusException(status);
+#else
+		Py_IsolatedFlag = 1;
+		Py_NoSiteFlag = 1;
+		Py_IgnoreEnvironmentFlag = 1;
+		Py_NoUserSiteDirectory = 1;
+		Py_Initialize();
+#endif
 	}
+	else
+		Py_Initialize();
 
-	return result;
+	AppendModulePath();
+	ConfigureBytecodeCache();
 }
 
-std::string encode_strip(const std::string &str)
+void ModuleSystem::ConfigureBytecodeCache()
 {
-	std::string text = str;
-	trim(text);
-	return encode_full(text);
-}
+#if PY_VERSION_HEX >= 0x03080000
+	if (!(m_flags & (MSF_BYTECODE_CACHE | MSF_PREWARM))) return;
 
-std::string encode_id(const std::string &str)
-{
-	std::string text = encode_full(str);
-	std::transform(text.begin(), text.end(), text.begin(), ::tolower);
-	return text;
+	// The cache mirrors the absolute source path, so a moved module system starts with an empty cache
+	CPyString prefix(m_cache_path);
+
+	if (PySys_SetObject("pycache_prefix", prefix.GetRawObject())) throw CPyException("cannot set bytecode cache path");
+#endif
 }
 
-ModuleSystem::ModuleSystem(const std::string &in_path, const std::string &out_path) : m_input_path(in_path), m_output_path(out_path)
+// Bytecode is stored as checked hash-based pycs, so a cached module is only used while its source hash matches
+void ModuleSystem::CompileBytecode(const std::string &path, bool force)
 {
-#if defined _WIN32
-	m_console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
-	GetConsoleScreenBufferInfo(m_console_handle, &m_console_info);
+#if PY_VERSION_HEX >= 0x03080000
+	MappedFile source_file;
+
+	if (!source_file.Open(path)) return;
+
+	std::string source(source_file.GetData());
+	CPyModule importlib_util("importlib.util");
+	CPyTuple cache_args(1);
+	CPyTuple hash_args(1);
+
+	source_file.Close();
+	cache_args.SetItem(0, CPyString(path));
+	hash_args.SetItem(0, CPyObject(PyBytes_FromStringAndSize(source.data(), source.size())));
+
+	std::string cache_path(importlib_util.GetAttr("cache_from_source").Call(cache_args).AsString().View());
+	CPyObject magic = importlib_util.GetAttr("MAGIC_NUMBER");
+	CPyObject hash = importlib_util.GetAttr("source_hash").Call(hash_args);
+	std::string data(PyBytes_AsString(magic.GetRawObject()), 4);
+
+	data.append("\3\0\0\0", 4);
+	data.append(PyBytes_AsString(hash.GetRawObject()), 8);
+
+	if (!force)
+	{
+		char header[16];
+		std::ifstream stream(cache_path, std::ios::binary);
+
+		if (stream.read(header, sizeof(header)) && !memcmp(header, data.data(), sizeof(header))) return;
+	}
+
+	// Sources that fail to compile are skipped quietly, the import reports the error
+	CPyObject code(Py_CompileStringExFlags(source.c_str(), path.c_str(), Py_file_input, nullptr, -1));
+
+	if (!code.GetRawObject())
+	{
+		PyErr_Clear();
+		return;
+	}
+
+	CPyObject bytecode(PyMarshal_WriteObjectToString(code.GetRawObject(), Py_MARSHAL_VERSION));
+
+	if (!bytecode.GetRawObject())
+	{
+		PyErr_Clear();
+		return;
+	}
+
+	std::error_code error;
+
+	data.append(PyBytes_AsString(bytecode.GetRawObject()), PyBytes_Size(bytecode.GetRawObject()));
+	std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), error);
+	OutputWriter::ReplaceFile(cache_path, data);
 #endif
-	LoadPythonInterpreter();
 }
 
-ModuleSystem::~ModuleSystem()
+void ModuleSystem::RefreshBytecodeCache()
 {
-	//UnloadPythonInterpreter();
+	if (m_flags & MSF_PREWARM) std::cout << "Prewarming bytecode cache..." << std::endl;
+
+	for (auto &entry : std::filesystem::directory_iterator(m_input_path))
+	{
+		if (entry.is_regular_file() && entry.path().extension() == ".py") CompileBytecode(entry.path().string(), (m_flags & MSF_PREWARM) != 0);
+	}
 }
 
-void ModuleSystem::LoadPythonInterpreter()
+void ModuleSystem::AppendModulePath()
 {
-	Py_Initialize();
-
 	PyObject *obj = PySys_GetObject("path");
 	Py_XINCREF(obj);
 
@@ -87,6 +149,102 @@ void ModuleSystem::UnloadPythonInterpreter()
 	Py_Finalize();
 }
 
+void ModuleSystem::InstallImportHook()
+{
+	static PyMethodDef import_hook_def = { "__import__", (PyCFunction)(void (*)(void))ImportHook, METH_VARARGS | METH_KEYWORDS, nullptr };
+
+	CPyModule builtins("builtins");
+	CPyObject self(PyCapsule_New(this, nullptr, nullptr));
+	CPyObject hook(PyCFunction_NewEx(&import_hook_def, self.GetRawObject(), nullptr));
+
+	m_builtin_import = builtins.GetAttr("__import__").GetRawObject();
+	Py_INCREF(m_builtin_import);
+	builtins.SetAttr("__import__", hook);
+}
+
+void ModuleSystem::RemoveImportHook()
+{
+	if (!m_builtin_import) return;
+
+	CPyModule builtins("builtins");
+
+	builtins.SetAttr("__import__", CPyObject(m_builtin_import));
+	m_builtin_import = nullptr;
+}
+
+void ModuleSystem::InstallIdModule(const std::string &name, const std::string &prefix, const std::vector<std::string> &ids)
+{
+	CPyModule module(PyModule_New(name.c_str()));
+
+	for (size_t i = 0; i < ids.size(); ++i) module.SetAttr(prefix + "_" + ids[i], CPyLong((long long)i));
+
+	if (PyDict_SetItemString(PyImport_GetModuleDict(), name.c_str(), module.GetRawObject())) throw CPyException("cannot install module " + name);
+
+	m_fresh_id_modules.insert(name);
+}
+
+void ModuleSystem::ReloadStaleModules()
+{
+	bool changed = true;
+
+	while (changed)
+	{
+		changed = false;
+
+		for (auto &module : m_module_imports)
+		{
+			if (m_stale_modules.count(module.first)) continue;
+
+			for (auto &name : module.second)
+			{
+				if (m_stale_modules.count(name))
+				{
+					m_stale_modules.insert(module.first);
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+
+	for (auto &name : m_module_order)
+	{
+		if (m_stale_modules.count(name)) CPyModule(name).Reload();
+	}
+}
+
+PyObject *ModuleSystem::ImportHook(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	ModuleSystem *ms = (ModuleSystem *)PyCapsule_GetPointer(self, nullptr);
+	PyObject *module = PyObject_Call(ms->m_builtin_import, args, kwargs);
+
+	if (!module || PyTuple_GET_SIZE(args) < 2) return module;
+
+	PyObject *name = PyTuple_GET_ITEM(args, 0);
+	PyObject *globals = PyTuple_GET_ITEM(args, 1);
+	PyObject *importer = PyDict_Check(globals) ? PyDict_GetItemString(globals, "__name__") : nullptr;
+
+	const char *name_ptr = PyUnicode_Check(name) ? PyUnicode_AsUTF8(name) : nullptr;
+
+	if (!name_ptr) return module;
+
+	std::string name_str(name_ptr);
+	const char *importer_ptr = importer && PyUnicode_Check(importer) ? PyUnicode_AsUTF8(importer) : nullptr;
+
+	if (importer_ptr)
+	{
+		std::string importer_str(importer_ptr);
+
+		ms->m_module_imports[importer_str].insert(name_str);
+
+		if (!name_str.compare(0, 3, "ID_") && !ms->m_fresh_id_modules.count(name_str)) ms->m_stale_modules.insert(importer_str);
+	}
+
+	if (std::find(ms->m_module_order.begin(), ms->m_module_order.end(), name_str) == ms->m_module_order.end()) ms->m_module_order.push_back(name_str);
+
+	return module;
+}
+
 void ModuleSystem::SetConsoleColor(int color)
 {
 #if defined _WIN32
@@ -105,31 +263,60 @@ void ModuleSystem::ResetConsoleColor()
 #endif
 }
 
-void ModuleSystem::Compile(unsigned long long flags)
+bool ModuleSystem::Compile(unsigned long long flags)
 {
 	m_flags = flags;
 
 	if (m_input_path.length() && m_input_path[m_input_path.length() - 1] != PATH_SEPARATOR) m_input_path.push_back(PATH_SEPARATOR);
 
+	if (m_cache_path.empty()) m_cache_path = m_input_path + "__bytecode_cache__";
+
 #if defined _WIN32
-	LARGE_INTEGER frequency, t1, t2;
+	LARGE_INTEGER frequency, t1, t2, t_startup;
 
 	QueryPerformanceFrequency(&frequency);
 	QueryPerformanceCounter(&t1);
 #else
-	timeval t1, t2;
+	timeval t1, t2, t_startup;
 
 	gettimeofday(&t1, NULL);
 #endif
 
 	try
 	{
+		LoadPythonInterpreter();
+
+#if defined _WIN32
+		QueryPerformanceCounter(&t_startup);
+#else
+		gettimeofday(&t_startup, NULL);
+#endif
+
+#if PY_VERSION_HEX < 0x03080000
+		if (m_flags & (MSF_BYTECODE_CACHE | MSF_PREWARM)) Warning(WL_WARNING, "bytecode cache requires Python 3.8 or newer");
+#else
+		if (m_flags & (MSF_BYTECODE_CACHE | MSF_PREWARM)) RefreshBytecodeCache();
+#endif
+
 		if (!(m_flags & MSF_SKIP_ID_FILES))
 		{
 			m_pass = 1;
-			DoCompile();
-			UnloadPythonInterpreter();
-			LoadPythonInterpreter();
+
+			if (m_flags & MSF_SINGLE_INTERPRETER)
+			{
+				InstallImportHook();
+				DoCompile();
+				RemoveImportHook();
+				ReloadStaleModules();
+			}
+			else
+			{
+				DoCompile();
+				UnloadPythonInterpreter();
+				LoadPythonInterpreter();
+			}
+
+			m_writer.Flush();
 		}
 
 		m_pass = 2;
@@ -141,10 +328,11 @@ void ModuleSystem::Compile(unsigned long long flags)
 		std::cout << "PYTHON ERROR: ";
 		ResetConsoleColor();
 		std::cout << e.GetText() << std::endl;
+		m_writer.Join();
 		SetConsoleColor(COLOR_MAGENTA);
 		std::cout << "COMPILATION ABORTED" << std::endl;
 		ResetConsoleColor();
-		return;
+		return false;
 	}
 	catch (CompileException &e)
 	{
@@ -152,43 +340,78 @@ void ModuleSystem::Compile(unsigned long long flags)
 		std::cout << "ERROR: ";
 		ResetConsoleColor();
 		std::cout << e.GetText() << std::endl;
+		m_writer.Join();
 		SetConsoleColor(COLOR_MAGENTA);
 		std::cout << "COMPILATION ABORTED" << std::endl;
 		ResetConsoleColor();
-		return;
+		return false;
 	}
 
-#if defined _WIN32
-	QueryPerformanceCounter(&t2);
-#else
-	gettimeofday(&t2, NULL);
-#endif
-
 	if (m_flags & MSF_LIST_RESOURCES)
 	{
-		std::ofstream res_stream(m_output_path + "resource_usage.txt");
+		OutputBuffer res_stream(m_output_path + "resource_usage.txt", m_writer);
 
 		std::string res_type_to_str[] = { "Meshes", "Materials", "Skeleton Models", "Bodies", "Skeleton Animations" };
 		for (auto & resource : m_resources)
 		{
 			std::string res_type = res_type_to_str[resource.first];
-			res_stream << "== " << res_type << " ==" << std::endl;
-			for (auto & res_it : resource.second) res_stream << res_it.first << ' ' << res_it.second << std::endl;
-			res_stream << std::endl;
+			res_stream << "== " << res_type << " ==\n";
+			for (auto & res_it : resource.second) res_stream << res_it.first << ' ' << res_it.second << '\n';
+			res_stream << '\n';
 		}
 	}
 
+	m_writer.Join();
+
+#if defined _WIN32
+	QueryPerformanceCounter(&t2);
+#else
+	gettimeofday(&t2, NULL);
+#endif
+
 #if defined _WIN32
 	double time = (t2.QuadPart - t1.QuadPart) * 1000.0 / frequency.QuadPart;
+	double startup_time = (t_startup.QuadPart - t1.QuadPart) * 1000.0 / frequency.QuadPart;
 #else
 	double time = ((t2.tv_sec - t1.tv_sec) * 1000.0) + (t2.tv_usec - t1.tv_usec) / 1000.0;
+	double startup_time = ((t_startup.tv_sec - t1.tv_sec) * 1000.0) + (t_startup.tv_usec - t1.tv_usec) / 1000.0;
 #endif
 
 	std::cout << std::endl << "Compile time: " << time << "ms" << std::endl;
+	std::cout << "Interpreter startup: " << startup_time << "ms" << std::endl;
+	std::cout << "Output files: " << m_writer.GetNumWritten() << " written, " << m_writer.GetNumUnchanged() << " unchanged";
+
+	if (m_writer.GetNumFailed()) std::cout << ", " << m_writer.GetNumFailed() << " failed";
+
+	std::cout << std::endl;
+
+	for (const auto &failure : m_writer.GetFailures())
+	{
+		SetConsoleColor(COLOR_RED);
+		std::cout << "ERROR: ";
+		ResetConsoleColor();
+		std::cout << "cannot write " << failure.first << ": " << failure.second << std::endl;
+	}
+
+	if (m_flags & MSF_STATISTICS)
+	{
+		std::cout << "Statements: " << m_num_statements << std::endl;
+#ifdef MS_ALLOCATION_STATS
+		std::cout << "Heap allocations while writing: " << m_write_allocations;
+
+		if (m_num_statements) std::cout << " (" << (double)m_write_allocations / m_num_statements << " per statement)";
+
+		std::cout << std::endl;
+#else
+		std::cout << "Heap allocations while writing: not counted (build with MS_ALLOCATION_STATS)" << std::endl;
+#endif
+	}
 
 #ifdef _WIN32
 	SetConsoleTitle("MS++ -- Finished");
 #endif
+
+	return m_writer.GetNumFailed() == 0;
 }
 
 void ModuleSystem::DoCompile()
@@ -201,96 +424,33 @@ void ModuleSystem::DoCompile()
 	{
 		std::cout << "Initializing compiler..." << std::endl;
 
-		memset(m_operations, 0, MAX_NUM_OPCODES * sizeof(unsigned int));
-		memset(m_operation_depths, 0, MAX_NUM_OPCODES * sizeof(int));
-
-		m_operation_depths[3] = -1; // try_end
-		m_operation_depths[4] = 1; // try_begin
-		m_operation_depths[6] = 1; // try_for_range
-		m_operation_depths[7] = 1; // try_for_range_backwards
-		m_operation_depths[11] = 1; // try_for_parties
-		m_operation_depths[12] = 1; // try_for_agents
-		m_operation_depths[15] = 1; // try_for_attached_parties (WSE)
-		m_operation_depths[16] = 1; // try_for_active_players (WSE)
-		m_operation_depths[17] = 1; // try_for_prop_instances (WSE)
-		m_operation_depths[18] = 1; // try_for_dict_keys (WSE)
-
-		CPyModule header_operations("header_operations");
-		CPyIter lhs_operations_iter = header_operations.GetAttr("lhs_operations").GetIter();
-		CPyIter ghs_operations_iter = header_operations.GetAttr("global_lhs_operations").GetIter();
-		CPyIter cf_operations_iter = header_operations.GetAttr("can_fail_operations").GetIter();
-
-		while (lhs_operations_iter.HasNext()) m_operations[OPCODE(lhs_operations_iter.Next().AsLong())] |= OPTYPE_LHS;
-		while (ghs_operations_iter.HasNext()) m_operations[OPCODE(ghs_operations_iter.Next().AsLong())] |= OPTYPE_GHS;
-		while (cf_operations_iter.HasNext()) m_operations[OPCODE(cf_operations_iter.Next().AsLong())] |= OPTYPE_CF;
-
-		if (!(m_flags * MSF_OBFUSCATE_GLOBAL_VARS))
-		{
-			std::ifstream global_var_stream("variables.txt");
-
-			if (!global_var_stream.is_open()) global_var_stream.open(m_output_path + "variables.txt");
-
-			if (global_var_stream.is_open())
-			{
-				int i = 0;
-
-				while (global_var_stream)
-				{
-					std::string global_var;
-
-					global_var_stream >> global_var;
+		LoadOperations();
 
-					if (!global_var.empty() && m_global_vars.find(global_var) == m_global_vars.end())
-					{
-						m_global_vars[global_var].index = i++;
-						m_global_vars[global_var].compat = true;
-					}
-				}
-			}
-		}
+		if (!(m_flags & MSF_OBFUSCATE_GLOBAL_VARS)) LoadCompatGlobalVariables("variables.txt");
 
 		std::cout << "Loading modules..." << std::endl;
 	}
 	else
 		std::cout << "Generating id files..." << std::endl;
 
-	m_animations = AddModule("animations", "animations", "anim", 25);
-	m_dialogs = AddModule("dialogs", "dialogs", "");
-	m_factions = AddModule("factions", "fac", 6);
-	m_game_menus = AddModule("game_menus", "game_menus", "mnu", "menus", "menu", 12);
-	m_info_pages = AddModule("info_pages", "ip");
-	m_items = AddModule("items", "itm", 4);
-	m_map_icons = AddModule("map_icons", "icon", 18);
-	m_meshes = AddModule("meshes", "mesh", 20);
-	m_music = AddModule("music", "tracks", "track", 23);
-	m_mission_templates = AddModule("mission_templates", "mission_templates", "mt", "mission_templates", "mst", 11);
-	m_particle_systems = AddModule("particle_systems", "psys", 14);
-	m_parties = AddModule("parties", "p", 9);
-	m_party_templates = AddModule("party_templates", "pt", 8);
-	m_postfx = AddModule("postfx", "postfx_params", "pfx", "postfx_params", "pfx");
-	m_presentations = AddModule("presentations", "prsnt", 21);
-	m_quests = AddModule("quests", "qst", 7);
-	m_scene_props = AddModule("scene_props", "spr", 15);
-	m_scenes = AddModule("scenes", "scn", 10);
-	m_scripts = AddModule("scripts", "script", 13);
-	m_simple_triggers = AddModule("simple_triggers", "");
-	m_skills = AddModule("skills", "skl", 19);
-	m_skins = AddModule("skins", "");
-	m_sounds = AddModule("sounds", "snd", 16);
-	m_strings = AddModule("strings", "str", 3);
-	m_tableau_materials = AddModule("tableau_materials", "tableaus", "tableau", 24);
-	m_triggers = AddModule("triggers", "");
-	m_troops = AddModule("troops", "trp", 5);
-
-	if (m_flags & MSF_COMPILE_MODULE_DATA)
+	if (m_pass == 2 && m_flags & MSF_PARALLEL_IMPORT && !(m_flags & MSF_SINGLE_INTERPRETER))
 	{
-		m_flora_kinds = AddModule("flora_kinds", "fauna_kinds", "");
-		m_skyboxes = AddModule("skyboxes", "skyboxes", "");
-		m_ground_specs = AddModule("ground_specs", "ground_specs", "");
+		m_module_requests.clear();
+		m_collect_modules = true;
+		LoadModules();
+		m_collect_modules = false;
+		ImportModulesParallel();
 	}
 
+	LoadModules();
+
 	if (m_pass == 2)
 	{
+		m_snapshot.ReleaseSources();
+		UnloadPythonInterpreter();
+
+		size_t allocations = GetAllocationCount();
+
 		WriteStrings();
 		WriteSkills();
 		WriteMusic();
@@ -329,285 +489,731 @@ void ModuleSystem::DoCompile()
 		WriteQuickStrings();
 		WriteGlobalVars();
 
-		for (auto & var : m_global_vars)
+		m_write_allocations = GetAllocationCount() - allocations;
+
+		std::vector<const Variable *> suspicious_vars;
+
+		for (const Variable &var : m_global_vars)
 		{
-			if (!var.second.compat && var.second.assignments == 0) Warning(WL_WARNING, "usage of unassigned global variable $" + var.first);
-			if (!var.second.compat && var.second.usages == 0) Warning(WL_WARNING, "unused global variable $" + var.first);
+			if (!var.compat && (var.assignments == 0 || var.usages == 0)) suspicious_vars.push_back(&var);
 		}
 
-		if (m_flags & MSF_LIST_UNREFERENCED_SCRIPTS)
+		std::sort(suspicious_vars.begin(), suspicious_vars.end(), [](const Variable *left, const Variable *right) { return left->name < right->name; });
+
+		for (const Variable *var : suspicious_vars)
 		{
-			auto& uses_map = m_uses["script"];
+			if (var->assignments == 0) Warning(WL_WARNING, "usage of unassigned global variable $" + std::string(var->name));
+			if (var->usages == 0) Warning(WL_WARNING, "unused global variable $" + std::string(var->name));
+		}
 
-			for (auto & it : uses_map)
+		if (m_flags & (MSF_LIST_UNREFERENCED_SCRIPTS | MSF_LIST_UNREFERENCED))
+		{
+			for (int i = 0; i < m_symbols.GetNumPrefixes(); ++i)
 			{
-				if (!it.second && it.first.find("game_") && it.first.find("wse_")) Warning(WL_WARNING, "unreferenced script " + it.first);
+				if (i != EK_SCRIPT && !(m_flags & MSF_LIST_UNREFERENCED)) continue;
+
+				for (std::string_view name : m_symbols.GetUnused(i))
+				{
+					if (i != EK_SCRIPT)
+						Warning(WL_WARNING, "unreferenced identifier " + std::string(m_symbols.GetPrefix(i)) + "_" + std::string(name));
+					else if (!is_engine_script(name))
+						Warning(WL_WARNING, "unreferenced script " + std::string(name));
+				}
 			}
 		}
 	}
 };
 
-CPyList ModuleSystem::AddModule(const std::string &module_name, const std::string &list_name, const std::string &prefix, const std::string &id_name, const std::string &id_prefix, int tag)
+void ModuleSystem::LoadModules()
 {
-	std::string module_name_full = "module_" + module_name;
-	CPyModule module(module_name_full);
-	CPyList list = module.GetAttr(list_name);
+	m_animations = AddModule(EK_ANIMATION);
+	m_dialogs = AddModule(EK_DIALOG);
+	m_factions = AddModule(EK_FACTION);
+	m_game_menus = AddModule(EK_GAME_MENU);
+	m_info_pages = AddModule(EK_INFO_PAGE);
+	m_items = AddModule(EK_ITEM);
+	m_map_icons = AddModule(EK_MAP_ICON);
+	m_meshes = AddModule(EK_MESH);
+	m_music = AddModule(EK_MUSIC);
+	m_mission_templates = AddModule(EK_MISSION_TEMPLATE);
+	m_particle_systems = AddModule(EK_PARTICLE_SYSTEM);
+	m_parties = AddModule(EK_PARTY);
+	m_party_templates = AddModule(EK_PARTY_TEMPLATE);
+	m_postfx = AddModule(EK_POSTFX);
+	m_presentations = AddModule(EK_PRESENTATION);
+	m_quests = AddModule(EK_QUEST);
+	m_scene_props = AddModule(EK_SCENE_PROP);
+	m_scenes = AddModule(EK_SCENE);
+	m_scripts = AddModule(EK_SCRIPT);
+	m_simple_triggers = AddModule(EK_SIMPLE_TRIGGER);
+	m_skills = AddModule(EK_SKILL);
+	m_skins = AddModule(EK_SKIN);
+	m_sounds = AddModule(EK_SOUND);
+	m_strings = AddModule(EK_STRING);
+	m_tableau_materials = AddModule(EK_TABLEAU);
+	m_triggers = AddModule(EK_TRIGGER);
+	m_troops = AddModule(EK_TROOP);
 
-	if (!prefix.empty())
+	if (m_flags & MSF_COMPILE_MODULE_DATA)
 	{
-		int num_entries = (int)list.Size();
-		std::vector<std::string> ids(num_entries);
+		m_flora_kinds = AddModule(EK_FLORA_KIND);
+		m_skyboxes = AddModule(EK_SKYBOX);
+		m_ground_specs = AddModule(EK_GROUND_SPEC);
+	}
+}
 
-		for (int i = 0; i < num_entries; ++i)
+void ModuleSystem::ImportModulesParallel()
+{
+#if PY_VERSION_HEX >= 0x030C0000
+	size_t num_modules = m_module_requests.size();
+	size_t num_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), num_modules);
+
+	if (num_threads < 2) return;
+
+	std::vector<std::pair<uintmax_t, size_t>> order;
+
+	for (size_t i = 0; i < num_modules; ++i)
+	{
+		std::error_code error;
+		uintmax_t size = std::filesystem::file_size(m_input_path + m_module_requests[i].first + ".py", error);
+
+		order.push_back({ error ? 0 : size, i });
+	}
+
+	std::sort(order.begin(), order.end(), std::greater<>());
+
+	std::vector<DataSnapshot> snapshots(num_threads);
+	std::vector<DataNode> lists(num_modules);
+	std::vector<char> imported(num_modules, 0);
+	std::vector<std::string> module_errors(num_modules);
+	std::vector<std::string> thread_errors(num_threads);
+	std::vector<std::thread> threads;
+	std::atomic<size_t> next(0);
+	std::mutex interpreter_mutex;
+	PyThreadState *main_state = PyEval_SaveThread();
+	PyInterpreterState *main_interp = main_state->interp;
+
+	for (size_t t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]()
 		{
-			CPyObject item = list[i];
-			std::string name;
+			PyInterpreterConfig config = {};
+			PyThreadState *state = nullptr;
+			PyThreadState *creator_state;
 
-			if (item.IsTuple() || item.IsList())
-				name = item[0].AsString();
-			else
-				Warning(WL_CRITICAL, "unrecognized list format for " + list_name, module_name_full);
+			config.use_main_obmalloc = 0;
+			config.allow_threads = 1;
+			config.check_multi_interp_extensions = 1;
+			config.gil = PyInterpreterConfig_OWN_GIL;
+
+			{
+				std::lock_guard<std::mutex> lock(interpreter_mutex);
+
+				creator_state = PyThreadState_New(main_interp);
+				PyEval_RestoreThread(creator_state);
 
-			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+				PyStatus status = Py_NewInterpreterFromConfig(&state, &config);
 
-			if (m_pass == 2)
+				if (PyStatus_Exception(status))
+				{
+					thread_errors[t] = std::string("cannot create subinterpreter: ") + (status.err_msg ? status.err_msg : "unknown error");
+					PyThreadState_Clear(creator_state);
+					PyThreadState_DeleteCurrent();
+					return;
+				}
+			}
+
+			try
 			{
-				if (m_ids[prefix].find(name) == m_ids[prefix].end())
-					m_ids[prefix][name] = i;
-				else
-					Warning(WL_WARNING, "duplicate entry " + prefix + "_" + name, module_name_full);
+				AppendModulePath();
+				ConfigureBytecodeCache();
+
+				for (size_t i = next++; i < num_modules; i = next++)
+				{
+					size_t index = order[i].second;
+					auto &request = m_module_requests[index];
+
+					try
+					{
+						lists[index] = snapshots[t].Import(CPyModule(request.first).GetAttr(request.second));
+						imported[index] = 1;
+					}
+					catch (CPyException &e)
+					{
+						module_errors[index] = e.GetText();
+					}
+					catch (CompileException &e)
+					{
+						module_errors[index] = e.GetText();
+					}
+				}
+			}
+			catch (CPyException &e)
+			{
+				thread_errors[t] = "cannot set up subinterpreter: " + e.GetText();
+			}
+
+			snapshots[t].ReleaseSources();
+
+			std::lock_guard<std::mutex> lock(interpreter_mutex);
+
+			Py_EndInterpreter(state);
+			PyEval_RestoreThread(creator_state);
+			PyThreadState_Clear(creator_state);
+			PyThreadState_DeleteCurrent();
+		});
+	}
+
+	for (auto &thread : threads) thread.join();
+
+	PyEval_RestoreThread(main_state);
+
+	for (auto &snapshot : snapshots) m_snapshot.Adopt(snapshot);
+
+	for (const auto &error : thread_errors)
+	{
+		if (!error.empty()) Warning(WL_WARNING, "parallel import: " + error);
+	}
 
-				m_uses[prefix][name] = 0;
+	for (size_t i = 0; i < num_modules; ++i)
+	{
+		if (imported[i])
+			m_prefetched_modules[m_module_requests[i].first] = lists[i];
+		else if (!module_errors[i].empty())
+			Warning(WL_WARNING, "parallel import failed, importing serially: " + module_errors[i], m_module_requests[i].first);
+	}
+#endif
+}
+
+DataNode ModuleSystem::AddModule(int kind)
+{
+	const EntityKindInfo &info = entity_kinds[kind];
+	std::string module_name_full = "module_" + std::string(info.module_name);
+	std::string list_name(info.list_name);
+
+	if (m_collect_modules)
+	{
+		m_module_requests.push_back({ module_name_full, list_name });
+		return DataNode();
+	}
+
+	if (m_pass == 1)
+	{
+		// Pass 1 only needs the entry names for the ID files, so the list is read without converting it
+		CPySequence list = CPyModule(module_name_full).GetAttr(list_name).AsSequence();
+
+		if (!info.prefix.empty() && !(m_flags & MSF_SKIP_ID_FILES))
+		{
+			int num_entries = (int)list.Size();
+			std::vector<std::string> ids(num_entries);
+
+			for (int i = 0; i < num_entries; ++i)
+			{
+				CPyObject item = list[i];
+
+				if (!item.IsTuple() && !item.IsList()) Warning(WL_CRITICAL, "unrecognized list format for " + list_name, module_name_full);
+
+				ids[i] = item[0].AsString().View();
+				lower(ids[i]);
 			}
 
-			ids[i] = name;
+			std::string id_module_name = "ID_" + std::string(info.id_name);
+			OutputBuffer stream(m_input_path + id_module_name + ".py", m_writer);
+
+			for (int i = 0; i < num_entries; ++i) stream << info.id_prefix << "_" << ids[i] << " = " << i << '\n';
+
+			stream.Close();
+
+			// Modules loaded after this one import the ID file from disk unless it is installed directly
+			if (!(m_flags & MSF_SINGLE_INTERPRETER) || m_flags & (MSF_BYTECODE_CACHE | MSF_PREWARM)) m_writer.Flush();
+
+			if (m_flags & MSF_SINGLE_INTERPRETER) InstallIdModule(id_module_name, std::string(info.id_prefix), ids);
+
+			if (m_flags & (MSF_BYTECODE_CACHE | MSF_PREWARM)) CompileBytecode(m_input_path + id_module_name + ".py", false);
 		}
 
-		if (m_pass == 1 && !(m_flags & MSF_SKIP_ID_FILES))
+		return DataNode();
+	}
+
+	DataNode list = ImportModule(module_name_full, list_name);
+
+	if (!info.prefix.empty())
+	{
+		int num_entries = (int)list.Len();
+
+		m_symbols.SetKnown(kind);
+
+		for (int i = 0; i < num_entries; ++i)
 		{
-			std::ofstream stream(m_input_path + "ID_" + id_name + ".py");
+			const DataNode &item = list[i];
+			std::string_view name;
 
-			for (int i = 0; i < num_entries; ++i) stream << id_prefix << "_" << ids[i] << " = " << i << std::endl;
+			if (item.IsTuple() || item.IsList())
+				name = item[0].AsString();
+			else
+				Warning(WL_CRITICAL, "unrecognized list format for " + list_name, module_name_full);
+
+			if (m_symbols.Find(kind, name) < 0)
+			{
+				m_symbols.Add(kind, name, i);
+			}
+			else
+			{
+				std::string entry(name);
+
+				Warning(WL_WARNING, "duplicate entry " + std::string(info.prefix) + "_" + lower(entry), module_name_full);
+			}
 		}
 
-		if (m_pass == 2 && tag > 0 && ((!(m_flags & MSF_OBFUSCATE_TAGS)) || prefix == "str"))
-			m_tags[prefix] = (unsigned long long)tag << 56;
+		if (info.tag > 0 && ((!(m_flags & MSF_OBFUSCATE_TAGS)) || kind == EK_STRING))
+			m_symbols.SetTag(kind, (unsigned long long)info.tag << 56);
 	}
 
 	return list;
 };
 
-CPyList ModuleSystem::AddModule(const std::string &module_name, const std::string &list_name, const std::string &prefix, int tag)
+DataNode ModuleSystem::ImportModule(const std::string &module_name, const std::string &list_name)
 {
-	return AddModule(module_name, list_name, prefix, module_name, prefix, tag);
-};
+	auto it = m_prefetched_modules.find(module_name);
 
-CPyList ModuleSystem::AddModule(const std::string &module_name, const std::string &prefix, int tag)
-{
-	return AddModule(module_name, module_name, prefix, tag);
-};
+	if (it != m_prefetched_modules.end()) return it->second;
 
-int ModuleSystem::GetId(const std::string &type, const CPyObject &obj, const std::string &context)
+	CPyModule module(module_name);
+
+	return m_snapshot.Import(module.GetAttr(list_name));
+}
+
+int ModuleSystem::GetId(int kind, const DataNode &obj, std::string_view context)
 {
 	if (obj.IsString())
 	{
-		std::string prefix = type;
-		std::string str = obj.AsString();
+		std::string_view prefix = entity_kinds[kind].prefix;
+		std::string_view str = obj.AsString();
+		std::string_view value = !equals_lower(prefix, str.substr(0, prefix.length())) ? str : str.substr(std::min(prefix.length() + 1, str.length()));
 
-		std::transform(prefix.begin(), prefix.end(), prefix.begin(), ::tolower);
-		std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+		if (!m_symbols.IsKnown(kind))
+		{
+			Warning(WL_ERROR, "unrecognized identifier prefix " + std::string(prefix), context);
+			m_symbols.SetKnown(kind);
+		}
+
+		int symbol = m_symbols.Find(kind, value);
 
-		std::string value = str.substr(0, prefix.length()) != prefix ? str : str.substr(prefix.length() + 1);
+		if (symbol < 0)
+		{
+			std::string key(str);
 
-		if (m_ids.find(prefix) == m_ids.end()) Warning(WL_ERROR, "unrecognized identifier prefix " + prefix, context);
-		if (m_ids[prefix].find(value) == m_ids[prefix].end()) Warning(WL_ERROR, "unrecognized identifier " + str, context);
+			Warning(WL_ERROR, "unrecognized identifier " + lower(key), context);
+			symbol = m_symbols.Add(kind, value, 0, false);
+		}
 
-		return m_ids[prefix][value];
+		return m_symbols.GetId(symbol);
 	}
 	if (obj.IsLong())
 		return (long)obj.AsLong();
 
-	Warning(WL_CRITICAL, "unrecognized identifier type " + (std::string)obj.Type().Str() + " for " + (std::string)obj.Str(), context);
+	Warning(WL_CRITICAL, "unrecognized identifier type " + std::string(obj.TypeName()) + " for " + obj.Str(), context);
 	return -1;
 }
 
-unsigned long long ModuleSystem::GetOperandId(const CPyObject &obj, const std::string &context)
+unsigned long long ModuleSystem::GetOperandId(const DataNode &obj, const Location &location, bool cache)
 {
 	if (obj.IsString())
 	{
-		std::string str = obj.AsString();
-		ssize_t underscore_pos = str.find('_');
+		std::string_view str = obj.AsString();
+		size_t underscore_pos = str.find('_');
 
-		if (underscore_pos < 0) Warning(WL_ERROR, "invalid identifier " + str, context);
+		if (underscore_pos == std::string_view::npos)
+		{
+			Warning(WL_ERROR, "invalid identifier " + std::string(str), location);
+			cache = false;
+		}
 
-		std::string prefix = str.substr(0, underscore_pos);
-		std::string value = str.substr(underscore_pos + 1);
+		std::string_view prefix = str.substr(0, underscore_pos);
+		std::string_view value = underscore_pos == std::string_view::npos ? str : str.substr(underscore_pos + 1);
+		int prefix_index = m_symbols.FindPrefix(prefix);
 
-		std::transform(prefix.begin(), prefix.end(), prefix.begin(), ::tolower);
-		std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+		if (prefix_index < 0)
+		{
+			std::string prefix_name(prefix);
 
-		if (m_ids.find(prefix) == m_ids.end()) Warning(WL_ERROR, "unrecognized identifier prefix " + prefix, context);
-		if (m_ids[prefix].find(value) == m_ids[prefix].end()) Warning(WL_ERROR, "unrecognized identifier " + str, context);
+			Warning(WL_ERROR, "unrecognized identifier prefix " + lower(prefix_name), location);
+			prefix_index = m_symbols.AddPrefix(prefix);
+			cache = false;
+		}
+
+		int symbol = m_symbols.Find(prefix_index, value);
 
-		m_uses[prefix][value]++;
-		return m_ids[prefix][value] | m_tags[prefix];
+		if (symbol < 0)
+		{
+			Warning(WL_ERROR, "unrecognized identifier " + std::string(str), location);
+			symbol = m_symbols.Add(prefix_index, value, 0, false);
+			cache = false;
+		}
+
+		m_symbols.AddUse(symbol);
+
+		unsigned long long id = m_symbols.GetId(symbol) | m_symbols.GetTag(prefix_index);
+
+		if (cache) CacheOperand({ str.data(), id, symbol, -1 });
+
+		return id;
 	}
 	if (obj.IsLong())
 		return obj.AsLong();
 
-	Warning(WL_CRITICAL, "unrecognized identifier type " + (std::string)obj.Type().Str() + " for " + (std::string)obj.Str(), context);
+	Warning(WL_CRITICAL, "unrecognized identifier type " + std::string(obj.TypeName()) + " for " + obj.Str(), location);
 	return -1;
 }
 
-std::string ModuleSystem::GetResource(const CPyObject &obj, int resource_type, const std::string &context)
+std::string_view ModuleSystem::GetResource(std::string_view name, int resource_type)
 {
-	if (obj.IsString())
-	{
-		std::string resource_name = encode_res(obj.AsString());
+	std::string_view resource_name = EncodeRes(name);
 
-		if (resource_name != "0" && resource_name != "none")
-		{
-			if (m_resources[resource_type].find(resource_name) == m_resources[resource_type].end()) m_resources[resource_type][resource_name] = 0;
-			m_resources[resource_type][resource_name]++;
-		}
+	if (resource_name != "0" && resource_name != "none") m_resources[resource_type][resource_name]++;
 
-		return resource_name;
-	}
+	return resource_name;
+}
+
+std::string_view ModuleSystem::GetResource(const DataNode &obj, int resource_type, std::string_view context)
+{
+	if (obj.IsString())
+		return GetResource(obj.AsString(), resource_type);
 	if (obj.IsLong())
-		return obj.Str();
+		return m_text.Store(obj.Str());
 
-	Warning(WL_CRITICAL, "unrecognized resource type " + (std::string)obj.Type().Str() + " for " + (std::string)obj.Str(), context);
+	Warning(WL_CRITICAL, "unrecognized resource type " + std::string(obj.TypeName()) + " for " + obj.Str(), context);
 	return "0";
 }
 
-long long ModuleSystem::ParseOperand(const CPyObject &statement, int pos)
+// Encoded names live in m_text for the whole compile, so writers can pass them around as views
+std::string_view ModuleSystem::Encode(std::string_view str, std::string_view prefix, int encoding)
+{
+	char *data = m_text.Allocate<char>(prefix.size() + str.size() + 1);
+
+	memcpy(data, prefix.data(), prefix.size());
+	return std::string_view(data, prefix.size() + encode_chars(data + prefix.size(), str, encoding));
+}
+
+std::string_view ModuleSystem::EncodeStr(std::string_view str)
+{
+	return Encode(str, std::string_view(), 0);
+}
+
+std::string_view ModuleSystem::EncodeRes(std::string_view str)
+{
+	return Encode(str, std::string_view(), ENC_TRIM);
+}
+
+std::string_view ModuleSystem::EncodeFull(std::string_view str)
+{
+	return Encode(str, std::string_view(), ENC_FULL);
+}
+
+std::string_view ModuleSystem::EncodeStrip(std::string_view str)
+{
+	return Encode(str, std::string_view(), ENC_FULL | ENC_TRIM);
+}
+
+std::string_view ModuleSystem::EncodeId(std::string_view str, std::string_view prefix)
+{
+	return Encode(str, prefix, ENC_FULL | ENC_LOWER);
+}
+
+std::string_view ModuleSystem::Join(std::initializer_list<std::string_view> parts)
+{
+	size_t size = 0;
+
+	for (std::string_view part : parts) size += part.size();
+
+	char *data = m_text.Allocate<char>(size + 1);
+	char *pos = data;
+
+	for (std::string_view part : parts)
+	{
+		memcpy(pos, part.data(), part.size());
+		pos += part.size();
+	}
+
+	return std::string_view(data, size);
+}
+
+long long ModuleSystem::ParseOperand(const DataNode &statement, int pos)
 {
-	CPyObject operand = statement[pos];
+	const DataNode *operand_ptr = &statement[pos];
 
-	if ((operand.IsTuple() || operand.IsList()) && operand.Len() == 1) operand = operand[0];
+	if (operand_ptr->IsSequence() && operand_ptr->Len() == 1) operand_ptr = &(*operand_ptr)[0];
+
+	const DataNode &operand = *operand_ptr;
 
 	if (operand.IsString())
 	{
-		std::string str = operand.AsString();
+		std::string_view str = operand.AsString();
 
-		if (str[0] == ':')
+		if (!str.empty() && str[0] == ':')
 		{
-			std::string value = str.substr(1);
-			int index;
+			std::string_view value = str.substr(1);
+			bool assignment = pos == 1 && m_operations.Get(OPCODE(statement[0].AsLong())).flags & OPTYPE_LHS;
+			LocalVariable *var = FindLocalVariable(value);
 
-			if (m_local_vars.find(value) == m_local_vars.end())
+			if (!var)
 			{
-				index = (int)m_local_vars.size();
-				m_local_vars[value].index = index;
-				m_local_vars[value].assignments = 1;
-				m_local_vars[value].usages = 0;
+				// The slot table is full, so the variable cannot be tracked; the block is already invalid
+				if (!m_local_vars_exceeded) Warning(WL_ERROR, "maximum amount of local variables (128) exceeded", m_cur_location);
+
+				m_local_vars_exceeded = true;
+				return NUM_LOCAL_VAR_SLOTS | OPMASK_LOCAL_VARIABLE;
+			}
 
-				if (pos != 1 || !(m_operations[OPCODE(statement[0].AsLong())] & OPTYPE_LHS))
+			if (var->generation != m_local_var_generation)
+			{
+				var->name = m_local_var_names.Store(value);
+				var->generation = m_local_var_generation;
+				var->index = m_num_local_vars;
+				var->assignments = 1;
+				var->usages = 0;
+				m_local_var_slots[m_num_local_vars++] = (int)(var - m_local_vars.data());
+
+				if (!assignment)
 				{
-					Warning(WL_ERROR, "usage of unassigned local variable :" + value, m_cur_context + ", statement " + itostr(m_cur_statement));
-					m_local_vars[value].usages = 1;
+					Warning(WL_ERROR, "usage of unassigned local variable :" + std::string(value), m_cur_location);
+					var->usages = 1;
 				}
 			}
+			else if (assignment)
+				var->assignments++;
 			else
-			{
-				if (pos == 1 && m_operations[OPCODE(statement[0].AsLong())] & OPTYPE_LHS)
-					m_local_vars[value].assignments++;
-				else
-					m_local_vars[value].usages++;
+				var->usages++;
 
-				index = m_local_vars[value].index;
+			if (m_num_local_vars > MAX_NUM_LOCAL_VARS && !m_local_vars_exceeded)
+			{
+				Warning(WL_ERROR, "maximum amount of local variables (128) exceeded", m_cur_location);
+				m_local_vars_exceeded = true;
 			}
 
-			if (m_local_vars.size() > 128) Warning(WL_ERROR, "maximum amount of local variables (128) exceeded", m_cur_context + ", statement " + itostr(m_cur_statement));
-
-			return index | OPMASK_LOCAL_VARIABLE;
+			return var->index | OPMASK_LOCAL_VARIABLE;
 		}
-		if (str[0] == '$')
-		{
-			std::string value = str.substr(1);
-			int index;
 
-			if (m_global_vars.find(value) == m_global_vars.end())
-			{
-				index = (int)m_global_vars.size();
-				m_global_vars[value].index = index;
+		CachedOperand &cached = FindCachedOperand(str.data());
 
-				if (pos == 1 && m_operations[OPCODE(statement[0].AsLong())] & (OPTYPE_LHS | OPTYPE_GHS))
-					m_global_vars[value].assignments = 1;
-				else
-					m_global_vars[value].usages = 1;
-			}
-			else
+		if (cached.key)
+		{
+			if (cached.global_var >= 0)
 			{
-				if (pos == 1 && m_operations[OPCODE(statement[0].AsLong())] & (OPTYPE_LHS | OPTYPE_GHS))
-					m_global_vars[value].assignments++;
+				Variable &var = m_global_vars[cached.global_var];
+
+				if (pos == 1 && m_operations.Get(OPCODE(statement[0].AsLong())).flags & (OPTYPE_LHS | OPTYPE_GHS))
+					var.assignments++;
 				else
-					m_global_vars[value].usages++;
+					var.usages++;
 
-				m_global_vars[value].compat = false;
-				index = m_global_vars[value].index;
+				var.compat = false;
 			}
+			else if (cached.symbol >= 0)
+				m_symbols.AddUse(cached.symbol);
 
-			return index | OPMASK_GLOBAL_VARIABLE;
+			return cached.value;
 		}
-		if (str[0] == '@')
+		if (!str.empty() && str[0] == '$')
 		{
-			std::string id = encode_full(str.substr(1));
-			std::string text = encode_str(str.substr(1));
-			size_t auto_id_len = std::min<size_t>(20, text.length());
-			std::string auto_id;
-
-			do
-			{
-				auto_id = "qstr_" + id.substr(0, auto_id_len++);
-			} while (auto_id_len <= id.length() && (m_quick_strings.find(auto_id) != m_quick_strings.end() && m_quick_strings[auto_id].value != text));
+			std::string_view value = str.substr(1);
+			auto var_it = m_global_var_ids.find(value);
+			int index = var_it != m_global_var_ids.end() ? var_it->second : AddGlobalVariable(value, false);
+			Variable &var = m_global_vars[index];
 
-			if (auto_id_len > id.length())
-			{
-				std::string new_auto_id = auto_id;
-				int i = 1;
-				char buffer[20];
-
-				while (m_quick_strings.find(new_auto_id) != m_quick_strings.end() && m_quick_strings[new_auto_id].value != text)
-				{
-					_itoa(i++, buffer, 10);
-					new_auto_id = auto_id + buffer;
-				}
+			if (pos == 1 && m_operations.Get(OPCODE(statement[0].AsLong())).flags & (OPTYPE_LHS | OPTYPE_GHS))
+				var.assignments++;
+			else
+				var.usages++;
 
-				auto_id = std::move(new_auto_id);
-			}
+			var.compat = false;
+			CacheOperand({ str.data(), index | OPMASK_GLOBAL_VARIABLE, -1, index });
+			return index | OPMASK_GLOBAL_VARIABLE;
+		}
+		if (!str.empty() && str[0] == '@')
+		{
+			m_quick_string_buffer.resize(str.size());
+			m_quick_string_buffer.resize(encode_chars(&m_quick_string_buffer[0], str.substr(1), 0));
 
-			if (m_quick_strings.find(auto_id) == m_quick_strings.end())
-			{
-				int size = (int)m_quick_strings.size();
+			auto text_it = m_quick_string_texts.find(m_quick_string_buffer);
+			int index = text_it != m_quick_string_texts.end() ? text_it->second : AddQuickString(m_text.Store(m_quick_string_buffer));
+			unsigned long long operand_id = index | OPMASK_QUICK_STRING;
 
-				m_quick_strings[auto_id].index = size;
-				m_quick_strings[auto_id].value = std::move(text);
-			}
-
-			return m_quick_strings[auto_id].index | OPMASK_QUICK_STRING;
+			CacheOperand({ str.data(), operand_id, -1, -1 });
+			return operand_id;
 		}
-		return GetOperandId(operand, m_cur_context + ", statement " + itostr(m_cur_statement));
+		return GetOperandId(operand, m_cur_location, true);
 	}
 	if (operand.IsLong())
 		return operand.AsLong();
 	if (operand.IsFloat())
 		return (long long)((double)operand.AsFloat());
 
-	Warning(WL_CRITICAL, "unrecognized operand type " + (std::string)operand.Type().Str() + " for " + (std::string)operand.Str(), m_cur_context + ", statement " + itostr(m_cur_statement));
+	Warning(WL_CRITICAL, "unrecognized operand type " + std::string(operand.TypeName()) + " for " + operand.Str(), m_cur_location);
 	return -1;
 }
 
+void ModuleSystem::LoadOperations()
+{
+	MappedFile header_file;
+	unsigned long long header_hash = 0;
+	std::string cache_file = (std::filesystem::path(m_cache_path) / "header_operations.opcodes").string();
+	bool use_cache = (m_flags & MSF_BYTECODE_CACHE) && header_file.Open(m_input_path + "header_operations.py");
+
+	m_operations.Clear();
+	m_operations.SetDepth(3, -1); // try_end
+	m_operations.SetDepth(4, 1); // try_begin
+	m_operations.SetDepth(6, 1); // try_for_range
+	m_operations.SetDepth(7, 1); // try_for_range_backwards
+	m_operations.SetDepth(11, 1); // try_for_parties
+	m_operations.SetDepth(12, 1); // try_for_agents
+	m_operations.SetDepth(15, 1); // try_for_attached_parties (WSE)
+	m_operations.SetDepth(16, 1); // try_for_active_players (WSE)
+	m_operations.SetDepth(17, 1); // try_for_prop_instances (WSE)
+	m_operations.SetDepth(18, 1); // try_for_dict_keys (WSE)
+
+	if (use_cache)
+	{
+		header_hash = OperationTable::Hash(header_file.GetData());
+
+		if (m_operations.Load(cache_file, header_hash)) return;
+	}
+
+	CPyModule header_operations("header_operations");
+	CPyIter lhs_operations_iter = header_operations.GetAttr("lhs_operations").GetIter();
+	CPyIter ghs_operations_iter = header_operations.GetAttr("global_lhs_operations").GetIter();
+	CPyIter cf_operations_iter = header_operations.GetAttr("can_fail_operations").GetIter();
+
+	while (lhs_operations_iter.HasNext()) m_operations.AddFlags(OPCODE(lhs_operations_iter.Next().AsLong()), OPTYPE_LHS);
+	while (ghs_operations_iter.HasNext()) m_operations.AddFlags(OPCODE(ghs_operations_iter.Next().AsLong()), OPTYPE_GHS);
+	while (cf_operations_iter.HasNext()) m_operations.AddFlags(OPCODE(cf_operations_iter.Next().AsLong()), OPTYPE_CF);
+
+	if (use_cache)
+	{
+		std::error_code error;
+
+		std::filesystem::create_directories(m_cache_path, error);
+		m_operations.Save(cache_file, header_hash);
+	}
+}
+
+int ModuleSystem::AddGlobalVariable(std::string_view name, bool compat)
+{
+	int index = (int)m_global_vars.size();
+	std::string_view stored_name = m_text.Store(name);
+
+	m_global_vars.push_back({ stored_name, 0, 0, compat });
+	m_global_var_ids[stored_name] = index;
+	return index;
+}
+
+void ModuleSystem::LoadCompatGlobalVariables(const std::string &path)
+{
+	MappedFile file;
+
+	if (!file.Open(path) && !file.Open(m_output_path + path)) return;
+
+	std::string_view data = file.GetData();
+	size_t pos = 0;
+
+	while (pos < data.size())
+	{
+		size_t start = pos;
+
+		while (pos < data.size() && !isspace((unsigned char)data[pos])) pos++;
+
+		std::string_view name = data.substr(start, pos - start);
+
+		if (!name.empty() && m_global_var_ids.find(name) == m_global_var_ids.end()) AddGlobalVariable(name, true);
+
+		pos++;
+	}
+}
+
+LocalVariable *ModuleSystem::FindLocalVariable(std::string_view name)
+{
+	size_t slot = std::hash<std::string_view>()(name);
+
+	for (int i = 0; i < NUM_LOCAL_VAR_SLOTS; ++i, ++slot)
+	{
+		LocalVariable &var = m_local_vars[slot % NUM_LOCAL_VAR_SLOTS];
+
+		if (var.generation != m_local_var_generation || var.name == name) return &var;
+	}
+
+	return nullptr;
+}
+
+// Operands are cached by the address of their string, which stays valid as long as the module data does
+CachedOperand &ModuleSystem::FindCachedOperand(const char *key)
+{
+	size_t mask = m_operand_cache.size() - 1;
+
+	for (size_t slot = ((uintptr_t)key * 0x9E3779B97F4A7C15ull) >> 32; ; ++slot)
+	{
+		CachedOperand &operand = m_operand_cache[slot & mask];
+
+		if (!operand.key || operand.key == key) return operand;
+	}
+}
+
+void ModuleSystem::CacheOperand(const CachedOperand &operand)
+{
+	CachedOperand &slot = FindCachedOperand(operand.key);
+
+	if (!slot.key) m_num_cached_operands++;
+
+	slot = operand;
+
+	if (m_num_cached_operands * 2 <= m_operand_cache.size()) return;
+
+	std::vector<CachedOperand> operands(m_operand_cache.size() * 2, CachedOperand());
+
+	m_operand_cache.swap(operands);
+
+	for (const CachedOperand &cached : operands)
+	{
+		if (cached.key) FindCachedOperand(cached.key) = cached;
+	}
+}
+
+int ModuleSystem::AddQuickString(std::string_view text)
+{
+	int index = (int)m_quick_strings.size();
+	std::string_view auto_id = Encode(text, "qstr_", ENC_FULL);
+	size_t auto_id_len = std::min<size_t>(20, text.length()) + 5;
+
+	while (auto_id_len < auto_id.length() && m_quick_string_ids.count(auto_id.substr(0, auto_id_len))) auto_id_len++;
+
+	if (auto_id_len < auto_id.length())
+		auto_id = auto_id.substr(0, auto_id_len);
+	else if (m_quick_string_ids.count(auto_id))
+	{
+		int &suffix = m_quick_string_suffixes[auto_id];
+		std::string_view base = auto_id;
+
+		do
+		{
+			auto_id = Join({ base, itostr(++suffix) });
+		} while (m_quick_string_ids.count(auto_id));
+	}
+
+	m_quick_strings.push_back({ auto_id, text });
+	m_quick_string_ids[m_quick_strings.back().id] = index;
+	m_quick_string_texts[m_quick_strings.back().value] = index;
+	return index;
+}
+
 void ModuleSystem::PrepareModule(const std::string &name)
 {
 	std::cout << "Compiling " << name << "..." << std::endl;
 }
 
-void ModuleSystem::Warning(int level, const std::string &text, const std::string &context)
+void ModuleSystem::Warning(int level, const std::string &text, std::string_view context)
 {
 	std::string error = text;
 
-	if (!context.empty()) error += " at " + context;
+	if (!context.empty()) error.append(" at ").append(context);
 
 	if (level == WL_CRITICAL || (level == WL_ERROR && m_flags & MSF_STRICT)) throw CompileException(error);
 
@@ -628,19 +1234,40 @@ void ModuleSystem::Warning(int level, const std::string &text, const std::string
 	}
 }
 
+void ModuleSystem::Warning(int level, const std::string &text, const Location &location)
+{
+	if (m_flags & MSF_DISABLE_WARNINGS && level != WL_CRITICAL && !(level == WL_ERROR && m_flags & MSF_STRICT)) return;
+
+	std::string context(location.entity);
+
+	if (!location.item.empty()) context += ", " + std::string(location.item);
+
+	if (location.trigger_type == LOC_SIMPLE_TRIGGER)
+		context += ", simple trigger " + itostr(location.trigger);
+	else if (location.trigger_type == LOC_TRIGGER)
+		context += ", trigger " + itostr(location.trigger);
+
+	if (location.block == LOC_CONDITIONS)
+		context += ", conditions";
+	else if (location.block == LOC_CONSEQUENCES)
+		context += ", consequences";
+
+	if (location.statement >= 0) context += ", statement " + itostr(location.statement);
+
+	Warning(level, text, context);
+}
+
 void ModuleSystem::WriteAnimations()
 {
 	PrepareModule("animations");
 
-	std::ofstream stream(m_output_path + "actions.txt");
-	CPyIter iter = m_animations.GetIter();
+	OutputBuffer stream(m_output_path + "actions.txt", m_writer);
 
-	stream << m_animations.Size() << std::endl;
+	stream << m_animations.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &animation : m_animations)
 	{
-		CPyObject animation = iter.Next();
-		std::string name = encode_str(animation[0].AsString());
+		std::string_view name = EncodeStr(animation[0].AsString());
 
 		stream << ' ' << name << ' ';
 
@@ -653,9 +1280,9 @@ void ModuleSystem::WriteAnimations()
 
 		for (int i = 0; i < num_sequences; ++i)
 		{
-			CPyObject sequence = animation[i + 3];
+			const DataNode &sequence = animation[i + 3];
 
-			stream << std::endl << "  ";
+			stream << '\n' << "  ";
 			stream << sequence[0] << ' ';
 			stream << GetResource(sequence[1], RES_ANIMATION, name) << ' ';
 			stream << sequence[2] << ' ';
@@ -686,18 +1313,18 @@ void ModuleSystem::WriteAnimations()
 				stream << "0.0 ";
 		}
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
 void ModuleSystem::WriteDialogs() // TODO: optimize
 {
 	PrepareModule("dialogs");
-	std::ofstream states_stream(m_output_path + "dialog_states.txt");
+	OutputBuffer states_stream(m_output_path + "dialog_states.txt", m_writer);
 
-	std::map<std::string, int> states;
+	std::unordered_map<std::string_view, int> states;
 	int num_states = 15;
-	std::string default_states[] = {
+	std::string_view default_states[] = {
 		"start",
 		"party_encounter",
 		"prisoner_liberated",
@@ -718,30 +1345,28 @@ void ModuleSystem::WriteDialogs() // TODO: optimize
 	for (int i = 0; i < num_states; i++)
 	{
 		states[default_states[i]] = i;
-		states_stream << default_states[i] << std::endl;
+		states_stream << default_states[i] << '\n';
 	}
 
-	std::ofstream stream(m_output_path + "conversation.txt");
-	CPyIter	iter = m_dialogs.GetIter();
-	std::map<std::string, std::string> dialog_ids;
+	OutputBuffer stream(m_output_path + "conversation.txt", m_writer);
+	std::unordered_map<std::string_view, std::string_view> dialog_ids;
 
-	stream << "dialogsfile version 2" << std::endl;
-	stream << m_dialogs.Size() << std::endl;
+	stream << "dialogsfile version 2\n";
+	stream << m_dialogs.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &sentence : m_dialogs)
 	{
-		CPyObject sentence = iter.Next();
-		std::string input_token = sentence[1].AsString();
-		std::string output_token = sentence[4].AsString();
+		std::string_view input_token = sentence[1].AsString();
+		std::string_view output_token = sentence[4].AsString();
 
 		if (states.find(input_token) == states.end())
 		{
 			states.insert({ input_token, num_states++ });
 
 			if (m_flags & MSF_OBFUSCATE_DIALOG_STATES)
-				states_stream << "state_" << states[input_token] << std::endl;
+				states_stream << "state_" << states[input_token] << '\n';
 			else
-				states_stream << input_token << std::endl;
+				states_stream << input_token << '\n';
 		}
 
 		if (states.find(output_token) == states.end())
@@ -749,49 +1374,49 @@ void ModuleSystem::WriteDialogs() // TODO: optimize
 			states.insert({ output_token, num_states++ });
 
 			if (m_flags & MSF_OBFUSCATE_DIALOG_STATES)
-				states_stream << "state_" << states[output_token] << std::endl;
+				states_stream << "state_" << states[output_token] << '\n';
 			else
-				states_stream << output_token << std::endl;
+				states_stream << output_token << '\n';
 		}
 
-		std::string text = encode_str(sentence[3].AsString());
+		std::string_view text = EncodeStr(sentence[3].AsString());
+		std::string_view auto_id = Join({ EncodeId(input_token, "dlga_"), ":", EncodeId(output_token) });
+		auto id_it = dialog_ids.find(auto_id);
 
-		std::string auto_id = "dlga_" + encode_id(input_token) + ":" + encode_id(output_token);
-		std::string new_auto_id = auto_id;
-		int i = 1;
-		char buff[20] = { '.', '\0' };
-
-		if (dialog_ids.find(new_auto_id) != dialog_ids.end() && dialog_ids[new_auto_id] != text)
+		if (id_it != dialog_ids.end() && id_it->second != text)
 		{
-			while (dialog_ids.find(new_auto_id) != dialog_ids.end())
+			std::string_view base_id = auto_id;
+			int i = 1;
+			char buff[20] = { '.', '\0' };
+
+			while (dialog_ids.find(auto_id) != dialog_ids.end())
 			{
 				sprintf(buff + 1, "%d", i++);
-				new_auto_id = auto_id + buff;
+				auto_id = Join({ base_id, buff });
 			}
 		}
 
-		auto_id = std::move(new_auto_id);
 		dialog_ids[auto_id] = text;
 
-		if (states.find(input_token) == states.end()) Warning(WL_ERROR, "input token not found: " + input_token, auto_id);
+		if (states.find(input_token) == states.end()) Warning(WL_ERROR, "input token not found: " + std::string(input_token), auto_id);
 
 		stream << auto_id << ' ';
 		stream << sentence[0] << ' ';
 		stream << states[input_token] << ' ';
-		WriteStatementBlock(sentence[2], stream, auto_id);
+		WriteStatementBlock(sentence[2], stream, Location(auto_id));
 
 		if (text.empty()) text = "NO_TEXT";
 
 		stream << text << ' ';
 		stream << states[output_token] << ' ';
-		WriteStatementBlock(sentence[5], stream, auto_id);
+		WriteStatementBlock(sentence[5], stream, Location(auto_id));
 
 		if (sentence.Len() > 6)
-			stream << encode_str(sentence[6].AsString()) << ' ';
+			stream << EncodeStr(sentence[6].AsString()) << ' ';
 		else
 			stream << "NO_VOICEOVER ";
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -799,7 +1424,7 @@ void ModuleSystem::WriteFactions()
 {
 	PrepareModule("factions");
 
-	std::ofstream stream(m_output_path + "factions.txt");
+	OutputBuffer stream(m_output_path + "factions.txt", m_writer);
 	int num_factions = (int)m_factions.Len();
 	double **relations = new double*[num_factions];
 	for (int i = 0; i < num_factions; i++)
@@ -811,15 +1436,13 @@ void ModuleSystem::WriteFactions()
 
 	for (int i = 0; i < num_factions; ++i)
 	{
-		CPyObject faction = m_factions[i];
-		CPyIter relation_iter = faction[4].GetIter();
+		const DataNode &faction = m_factions[i];
 
 		relations[i][i] = faction[3].AsFloat();
 
-		while (relation_iter.HasNext())
+		for (const DataNode &relation : faction[4])
 		{
-			CPyObject relation = relation_iter.Next();
-			int other_id = GetId("fac", relation[0], (std::string)faction[0].AsString() + " relations");
+			int other_id = GetId(EK_FACTION, relation[0], (std::string)faction[0].AsString() + " relations");
 			double value = relation[1].AsFloat();
 
 			relations[i][other_id] = value;
@@ -830,15 +1453,15 @@ void ModuleSystem::WriteFactions()
 		}
 	}
 
-	stream << "factionsfile version 1" << std::endl;
-	stream << num_factions << std::endl;
+	stream << "factionsfile version 1\n";
+	stream << num_factions << '\n';
 
 	for (int i = 0; i < num_factions; ++i)
 	{
-		CPyObject faction = m_factions[i];
+		const DataNode &faction = m_factions[i];
 
-		stream << "fac_" << encode_id(faction[0].AsString()) << ' ';
-		stream << encode_str(faction[1].AsString()) << ' ';
+		stream << "fac_" << EncodeId(faction[0].AsString()) << ' ';
+		stream << EncodeStr(faction[1].AsString()) << ' ';
 		stream << faction[2] << ' ';
 
 		if (faction.Len() > 6)
@@ -850,15 +1473,14 @@ void ModuleSystem::WriteFactions()
 
 		if (faction.Len() > 5)
 		{
-			CPyObject ranks = faction[5];
-			CPyIter rank_iter = ranks.GetIter();
+			const DataNode &ranks = faction[5];
 
 			stream << ranks.Len() << ' ';
 
-			while (rank_iter.HasNext()) stream << encode_str(rank_iter.Next().AsString()) << ' ';
+			for (const DataNode &rank : ranks) stream << EncodeStr(rank.AsString()) << ' ';
 		}
 
-		stream << std::endl;
+		stream << '\n';
 	}
 
 	for (int i = 0; i < num_factions; i++) delete[] relations[i];
@@ -869,29 +1491,24 @@ void ModuleSystem::WriteFloraKinds()
 {
 	PrepareModule("flora kinds");
 
-	std::ofstream stream(m_output_path + "Data" + PATH_SEPARATOR + "flora_kinds.txt");
-	CPyIter	iter = m_flora_kinds.GetIter();
+	OutputBuffer stream(m_output_path + "Data" + PATH_SEPARATOR + "flora_kinds.txt", m_writer);
 
-	stream << m_flora_kinds.Size() << std::endl;
+	stream << m_flora_kinds.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &flora_kind : m_flora_kinds)
 	{
-		CPyObject flora_kind = iter.Next();
-		std::string name = encode_strip(flora_kind[0].AsString());
-		unsigned long long flags = flora_kind[1].AsNumber();
+		std::string_view name = EncodeStrip(flora_kind[0].AsString());
+		unsigned long long flags = flora_kind[1].AsNumber().Low();
 
 		stream << name << ' ';
 		stream << flags << ' ';
 
-		CPyObject meshes = flora_kind[2];
-		CPyIter	meshes_iter = meshes.GetIter();
+		const DataNode &meshes = flora_kind[2];
 
 		stream << meshes.Len() << ' ';
 
-		while (meshes_iter.HasNext())
+		for (const DataNode &mesh : meshes)
 		{
-			CPyObject mesh = meshes_iter.Next();
-
 			stream << GetResource(mesh[0], RES_MESH, name) << ' ';
 
 			stream << (mesh.Len() > 1 ? GetResource(mesh[1], RES_BODY, name) : "0") << ' ';
@@ -909,7 +1526,7 @@ void ModuleSystem::WriteFloraKinds()
 			stream << flora_kind[4] << ' ';
 		}
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -917,17 +1534,13 @@ void ModuleSystem::WriteGlobalVars()
 {
 	PrepareModule("global variables");
 
-	std::ofstream stream(m_output_path + "variables.txt");
-	std::vector<std::string> global_vars(m_global_vars.size());
-	
-	for (auto & var : m_global_vars) global_vars[var.second.index] = var.first;
-
-	for (size_t i = 0; i < global_vars.size(); ++i)
+	OutputBuffer stream(m_output_path + "variables.txt", m_writer);
+	for (size_t i = 0; i < m_global_vars.size(); ++i)
 	{
 		if (m_flags & MSF_OBFUSCATE_GLOBAL_VARS)
-			stream << "global_var_" << i << std::endl;
+			stream << "global_var_" << i << '\n';
 		else
-			stream << global_vars[i] << std::endl;
+			stream << m_global_vars[i].name << '\n';
 	}
 }
 
@@ -935,14 +1548,12 @@ void ModuleSystem::WriteGroundSpecs()
 {
 	PrepareModule("ground specs");
 
-	std::ofstream stream(m_output_path + "Data" + PATH_SEPARATOR + "ground_specs.txt");
-	CPyIter	iter = m_ground_specs.GetIter();
+	OutputBuffer stream(m_output_path + "Data" + PATH_SEPARATOR + "ground_specs.txt", m_writer);
 
-	while (iter.HasNext())
+	for (const DataNode &ground_spec : m_ground_specs)
 	{
-		CPyObject ground_spec = iter.Next();
-		std::string name = encode_id(ground_spec[0].AsString());
-		unsigned int flags = (unsigned int)ground_spec[1].AsNumber();
+		std::string_view name = EncodeId(ground_spec[0].AsString());
+		unsigned int flags = (unsigned int)ground_spec[1].AsNumber().Low();
 
 		stream << name << ' ';
 		stream << flags << ' ';
@@ -957,7 +1568,7 @@ void ModuleSystem::WriteGroundSpecs()
 			stream << ground_spec[5][2] << ' ';
 		}
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -965,20 +1576,17 @@ void ModuleSystem::WriteInfoPages()
 {
 	PrepareModule("info pages");
 
-	std::ofstream stream(m_output_path + "info_pages.txt");
-	CPyIter iter = m_info_pages.GetIter();
+	OutputBuffer stream(m_output_path + "info_pages.txt", m_writer);
 
-	stream << "infopagesfile version 1" << std::endl;
-	stream << m_info_pages.Size() << std::endl;
+	stream << "infopagesfile version 1\n";
+	stream << m_info_pages.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &info_page : m_info_pages)
 	{
-		CPyObject info_page = iter.Next();
-
-		stream << "ip_" << encode_id(info_page[0].AsString()) << ' ';
-		stream << encode_str(info_page[1].AsString()) << ' ';
-		stream << encode_str(info_page[2].AsString()) << ' ';
-		stream << std::endl;
+		stream << "ip_" << EncodeId(info_page[0].AsString()) << ' ';
+		stream << EncodeStr(info_page[1].AsString()) << ' ';
+		stream << EncodeStr(info_page[2].AsString()) << ' ';
+		stream << '\n';
 	}
 }
 
@@ -986,22 +1594,20 @@ void ModuleSystem::WriteItems()
 {
 	PrepareModule("items");
 
-	std::ofstream stream(m_output_path + "item_kinds1.txt");
-	CPyIter iter = m_items.GetIter();
+	OutputBuffer stream(m_output_path + "item_kinds1.txt", m_writer);
 
-	stream << "itemsfile version 3" << std::endl;
-	stream << m_items.Size() << std::endl;
+	stream << "itemsfile version 3\n";
+	stream << m_items.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &item : m_items)
 	{
-		CPyObject item = iter.Next();
-		std::string name = "itm_" + encode_id(item[0].AsString());
+		std::string_view name = EncodeId(item[0].AsString(), "itm_");
 
 		stream << name << ' ';
-		stream << encode_str(item[1].AsString()) << ' ';
-		stream << encode_str(item[1].AsString()) << ' ';
+		stream << EncodeStr(item[1].AsString()) << ' ';
+		stream << EncodeStr(item[1].AsString()) << ' ';
 
-		CPyObject variations = item[2];
+		const DataNode &variations = item[2];
 		int num_variations = (int)variations.Len();
 
 		if (num_variations > 16)
@@ -1014,7 +1620,7 @@ void ModuleSystem::WriteItems()
 
 		for (int i = 0; i < num_variations; ++i)
 		{
-			CPyObject variation = variations[i];
+			const DataNode &variation = variations[i];
 
 			stream << GetResource(variation[0], RES_MESH, name) << ' ';
 			stream << variation[1] << ' ';
@@ -1025,7 +1631,7 @@ void ModuleSystem::WriteItems()
 		stream << item[5] << ' ';
 		stream << item[7] << ' ';
 
-		CPyNumber item_stats = item[6].AsNumber();
+		WideInt item_stats = item[6].AsNumber();
 		double weight = 0.25 * ((item_stats >> 24) & 0xFF);
 		int head_armor = (item_stats >> 0) & 0xFF;
 		int body_armor = (item_stats >> 8) & 0xFF;
@@ -1080,7 +1686,7 @@ void ModuleSystem::WriteItems()
 
 		if (item.Len() > 9)
 		{
-			CPyObject factions = item[9];
+			const DataNode &factions = item[9];
 			int num_factions = (int)factions.Len();
 
 			if (num_factions > 16)
@@ -1097,9 +1703,9 @@ void ModuleSystem::WriteItems()
 			stream << "0 ";
 
 		if (item.Len() > 8)
-			WriteSimpleTriggerBlock(item[8], stream, name);
+			WriteSimpleTriggerBlock(item[8], stream, Location(name));
 		else
-			stream << "0" << std::endl;
+			stream << "0\n";
 	}
 }
 
@@ -1107,22 +1713,20 @@ void ModuleSystem::WriteMapIcons()
 {
 	PrepareModule("map icons");
 
-	std::ofstream stream(m_output_path + "map_icons.txt");
-	CPyIter iter = m_map_icons.GetIter();
+	OutputBuffer stream(m_output_path + "map_icons.txt", m_writer);
 
-	stream << "map_icons_file version 1" << std::endl;
-	stream << m_map_icons.Size() << std::endl;
+	stream << "map_icons_file version 1\n";
+	stream << m_map_icons.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &map_icon : m_map_icons)
 	{
-		CPyObject map_icon = iter.Next();
-		std::string name = encode_id(map_icon[0].AsString());
+		std::string_view name = EncodeId(map_icon[0].AsString());
 
 		stream << name << ' ';
 		stream << map_icon[1] << ' ';
 		stream << GetResource(map_icon[2], RES_MESH, name) << ' ';
 		stream << map_icon[3] << ' ';
-		stream << GetId("snd", map_icon[4], name) << ' ';
+		stream << GetId(EK_SOUND, map_icon[4], name) << ' ';
 
 		int trigger_pos;
 
@@ -1142,9 +1746,9 @@ void ModuleSystem::WriteMapIcons()
 		}
 
 		if (map_icon.Len() > trigger_pos)
-			WriteSimpleTriggerBlock(map_icon[trigger_pos], stream, name);
+			WriteSimpleTriggerBlock(map_icon[trigger_pos], stream, Location(name));
 		else
-			stream << "0 " << std::endl;
+			stream << "0 \n";
 	}
 }
 
@@ -1152,46 +1756,42 @@ void ModuleSystem::WriteMenus()
 {
 	PrepareModule("game menus");
 
-	std::ofstream stream(m_output_path + "menus.txt");
-	CPyIter iter = m_game_menus.GetIter();
+	OutputBuffer stream(m_output_path + "menus.txt", m_writer);
 
-	stream << "menusfile version 1" << std::endl;
-	stream << m_game_menus.Size() << std::endl;
+	stream << "menusfile version 1\n";
+	stream << m_game_menus.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &menu : m_game_menus)
 	{
-		CPyObject menu = iter.Next();
-		std::string name = "menu_" + encode_id(menu[0].AsString());
+		std::string_view name = EncodeId(menu[0].AsString(), "menu_");
 
 		stream << name << ' ';
 		stream << menu[1] << ' ';
-		stream << encode_str(menu[2].AsString()) << ' ';
+		stream << EncodeStr(menu[2].AsString()) << ' ';
 		stream << GetResource(menu[3], RES_MESH, name) << ' ';
-		WriteStatementBlock(menu[4], stream, name);
+		WriteStatementBlock(menu[4], stream, Location(name));
 
-		CPyObject items = menu[5];
-		CPyIter item_iter = items.GetIter();
+		const DataNode &items = menu[5];
 
 		stream << items.Len() << ' ';
 
-		while (item_iter.HasNext())
+		for (const DataNode &item : items)
 		{
-			CPyObject item = item_iter.Next();
-			std::string item_name = "mno_" + encode_id(item[0].AsString());
+			std::string_view item_name = EncodeId(item[0].AsString(), "mno_");
 
-			stream << std::endl;
+			stream << '\n';
 			stream << item_name << ' ';
-			WriteStatementBlock(item[1], stream, name + ", " + item_name + ", conditions");
-			stream << encode_str(item[2].AsString()) << ' ';
-			WriteStatementBlock(item[3], stream, name + ", " + item_name + ", consequences");
+			WriteStatementBlock(item[1], stream, Location(name, item_name, LOC_CONDITIONS));
+			stream << EncodeStr(item[2].AsString()) << ' ';
+			WriteStatementBlock(item[3], stream, Location(name, item_name, LOC_CONSEQUENCES));
 
 			if (item.Len() > 4)
-				stream << encode_str(item[4].AsString()) << ' ';
+				stream << EncodeStr(item[4].AsString()) << ' ';
 			else
 				stream << ". ";
 		}
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1199,15 +1799,13 @@ void ModuleSystem::WriteMeshes()
 {
 	PrepareModule("meshes");
 
-	std::ofstream stream(m_output_path + "meshes.txt");
-	CPyIter iter = m_meshes.GetIter();
+	OutputBuffer stream(m_output_path + "meshes.txt", m_writer);
 
-	stream << m_meshes.Size() << std::endl;
+	stream << m_meshes.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &mesh : m_meshes)
 	{
-		CPyObject mesh = iter.Next();
-		std::string name = "mesh_" + encode_id(mesh[0].AsString());
+		std::string_view name = EncodeId(mesh[0].AsString(), "mesh_");
 
 		stream << name << ' ';
 		stream << mesh[1] << ' ';
@@ -1221,7 +1819,7 @@ void ModuleSystem::WriteMeshes()
 		stream << mesh[9] << ' ';
 		stream << mesh[10] << ' ';
 		stream << mesh[11] << ' ';
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1229,31 +1827,29 @@ void ModuleSystem::WriteMissionTemplates()
 {
 	PrepareModule("mission templates");
 
-	std::ofstream stream(m_output_path + "mission_templates.txt");
-	CPyIter iter = m_mission_templates.GetIter();
+	OutputBuffer stream(m_output_path + "mission_templates.txt", m_writer);
 
-	stream << "missionsfile version 1" << std::endl;
-	stream << m_mission_templates.Size() << std::endl;
+	stream << "missionsfile version 1\n";
+	stream << m_mission_templates.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &mission_template : m_mission_templates)
 	{
-		CPyObject mission_template = iter.Next();
-		std::string name = "mst_" + encode_id(mission_template[0].AsString());
+		std::string_view name = EncodeId(mission_template[0].AsString(), "mst_");
 
 		stream << name << ' ';
-		stream << encode_id(mission_template[0].AsString()) << ' ';
+		stream << EncodeId(mission_template[0].AsString()) << ' ';
 		stream << mission_template[1] << ' ';
 		stream << mission_template[2] << ' ';
-		stream << encode_str(mission_template[3].AsString()) << ' ';
+		stream << EncodeStr(mission_template[3].AsString()) << ' ';
 
-		CPyObject groups = mission_template[4];
+		const DataNode &groups = mission_template[4];
 		int num_groups = (int)groups.Len();
 
 		stream << num_groups << ' ';
 
 		for (int j = 0; j < num_groups; ++j)
 		{
-			CPyObject group = groups[j];
+			const DataNode &group = groups[j];
 
 			stream << group[0] << ' ';
 			stream << group[1] << ' ';
@@ -1263,12 +1859,12 @@ void ModuleSystem::WriteMissionTemplates()
 
 			if (group.Len() > 5)
 			{
-				CPyObject overrides = group[5];
+				const DataNode &overrides = group[5];
 				int num_overrides = (int)overrides.Len();
 
 				if (num_overrides > 8)
 				{
-					Warning(WL_WARNING, "item override count exceeds 8", name + ", group " + itostr(j));
+					Warning(WL_WARNING, "item override count exceeds 8", Join({ name, ", group ", itostr(j) }));
 					num_overrides = 8;
 				}
 
@@ -1280,7 +1876,7 @@ void ModuleSystem::WriteMissionTemplates()
 				stream << "0 ";
 		}
 
-		WriteTriggerBlock(mission_template[5], stream, name);
+		WriteTriggerBlock(mission_template[5], stream, Location(name));
 	}
 }
 
@@ -1288,21 +1884,19 @@ void ModuleSystem::WriteMusic()
 {
 	PrepareModule("music tracks");
 
-	std::ofstream stream(m_output_path + "music.txt");
-	CPyIter iter = m_music.GetIter();
+	OutputBuffer stream(m_output_path + "music.txt", m_writer);
 
-	stream << m_music.Size() << std::endl;
+	stream << m_music.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &track : m_music)
 	{
-		CPyObject track = iter.Next();
 		unsigned long long flags = track[2].AsLong();
 		unsigned long long continue_flags = track[3].AsLong();
 
-		stream << encode_str(track[1].AsString()) << ' ';
+		stream << EncodeStr(track[1].AsString()) << ' ';
 		stream << flags << ' ';
 		stream << (flags | continue_flags) << ' ';
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1310,16 +1904,14 @@ void ModuleSystem::WriteParticleSystems()
 {
 	PrepareModule("particle systems");
 
-	std::ofstream stream(m_output_path + "particle_systems.txt");
-	CPyIter iter = m_particle_systems.GetIter();
+	OutputBuffer stream(m_output_path + "particle_systems.txt", m_writer);
 
-	stream << "particle_systemsfile version 1" << std::endl;
-	stream << m_particle_systems.Size() << std::endl;
+	stream << "particle_systemsfile version 1\n";
+	stream << m_particle_systems.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &particle_system : m_particle_systems)
 	{
-		CPyObject particle_system = iter.Next();
-		std::string name = "psys_" + encode_id(particle_system[0].AsString());
+		std::string_view name = EncodeId(particle_system[0].AsString(), "psys_");
 
 		stream << name << ' ';
 		stream << particle_system[1] << ' ';
@@ -1333,8 +1925,8 @@ void ModuleSystem::WriteParticleSystems()
 
 		for (int i = 0; i < 10; i += 2)
 		{
-			CPyObject key1 = particle_system[i + 9];
-			CPyObject key2 = particle_system[i + 10];
+			const DataNode &key1 = particle_system[i + 9];
+			const DataNode &key2 = particle_system[i + 10];
 
 			stream << key1[0] << ' ';
 			stream << key1[1] << ' ';
@@ -1342,13 +1934,13 @@ void ModuleSystem::WriteParticleSystems()
 			stream << key2[1] << ' ';
 		}
 
-		CPyObject emit_box_size = particle_system[19];
+		const DataNode &emit_box_size = particle_system[19];
 
 		stream << emit_box_size[0] << ' ';
 		stream << emit_box_size[1] << ' ';
 		stream << emit_box_size[2] << ' ';
 
-		CPyObject emit_velocity = particle_system[20];
+		const DataNode &emit_velocity = particle_system[20];
 
 		stream << emit_velocity[0] << ' ';
 		stream << emit_velocity[1] << ' ';
@@ -1365,7 +1957,7 @@ void ModuleSystem::WriteParticleSystems()
 		else
 			stream << "0.0 ";
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1373,35 +1965,35 @@ void ModuleSystem::WriteParties()
 {
 	PrepareModule("parties");
 
-	std::ofstream stream(m_output_path + "parties.txt");
-	int num_parties = (int)m_parties.Size();
+	OutputBuffer stream(m_output_path + "parties.txt", m_writer);
+	int num_parties = (int)m_parties.Len();
 
-	stream << "partiesfile version 1" << std::endl;
-	stream << num_parties << std::endl;
-	stream << num_parties << std::endl;
+	stream << "partiesfile version 1\n";
+	stream << num_parties << '\n';
+	stream << num_parties << '\n';
 
 	for (int i = 0; i < num_parties; ++i)
 	{
-		CPyObject party = m_parties[i];
-		std::string name = "p_" + encode_id(party[0].AsString());
+		const DataNode &party = m_parties[i];
+		std::string_view name = EncodeId(party[0].AsString(), "p_");
 
 		stream << 1 << ' ' << i << ' ' << i << ' ';
 		stream << name << ' ';
-		stream << encode_str(party[1].AsString()) << ' ';
+		stream << EncodeStr(party[1].AsString()) << ' ';
 		stream << party[2] << ' ';
-		stream << GetId("menu", party[3], name) << ' ';
-		stream << GetId("pt", party[4], name) << ' ';
-		stream << GetId("fac", party[5], name) << ' ';
+		stream << GetId(EK_GAME_MENU, party[3], name) << ' ';
+		stream << GetId(EK_PARTY_TEMPLATE, party[4], name) << ' ';
+		stream << GetId(EK_FACTION, party[5], name) << ' ';
 		stream << party[6] << ' ';
 		stream << party[6] << ' ';
 		stream << party[7] << ' ';
 
-		int target_party_id = GetId("p", party[8], name);
+		int target_party_id = GetId(EK_PARTY, party[8], name);
 
 		stream << target_party_id << ' ';
 		stream << target_party_id << ' ';
 
-		CPyObject position = party[9];
+		const DataNode &position = party[9];
 
 		stream << position[0] << ' ';
 		stream << position[1] << ' ';
@@ -1411,27 +2003,27 @@ void ModuleSystem::WriteParties()
 		stream << position[1] << ' ';
 		stream << "0.0 ";
 
-		CPyObject members = party[10];
+		const DataNode &members = party[10];
 		int num_members = (int)members.Len();
 
 		stream << num_members << ' ';
 
 		for (int j = 0; j < num_members; ++j)
 		{
-			CPyObject member = members[j];
+			const DataNode &member = members[j];
 
-			stream << GetId("trp", member[0], name + ", member " + itostr(j)) << ' ';
+			stream << GetId(EK_TROOP, member[0], Join({ name, ", member ", itostr(j) })) << ' ';
 			stream << member[1] << ' ';
 			stream << "0 ";
 			stream << member[2] << ' ';
 		}
 
 		if (party.Len() > 11)
-			stream << std::setprecision(7) << (3.1415926 / 180.0) * party[11].AsFloat() << ' ';
+			stream << (3.1415926 / 180.0) * party[11].AsFloat() << ' ';
 		else
 			stream << "0.0 ";
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1439,25 +2031,23 @@ void ModuleSystem::WritePartyTemplates()
 {
 	PrepareModule("party templates");
 
-	std::ofstream stream(m_output_path + "party_templates.txt");
-	CPyIter iter = m_party_templates.GetIter();
+	OutputBuffer stream(m_output_path + "party_templates.txt", m_writer);
 
-	stream << "partytemplatesfile version 1" << std::endl;
-	stream << m_party_templates.Size() << std::endl;
+	stream << "partytemplatesfile version 1\n";
+	stream << m_party_templates.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &party_template : m_party_templates)
 	{
-		CPyObject party_template = iter.Next();
-		std::string name = "pt_" + encode_id(party_template[0].AsString());
+		std::string_view name = EncodeId(party_template[0].AsString(), "pt_");
 
 		stream << name << ' ';
-		stream << encode_str(party_template[1].AsString()) << ' ';
+		stream << EncodeStr(party_template[1].AsString()) << ' ';
 		stream << party_template[2] << ' ';
-		stream << GetId("menu", party_template[3], name) << ' ';
-		stream << GetId("fac", party_template[4], name) << ' ';
+		stream << GetId(EK_GAME_MENU, party_template[3], name) << ' ';
+		stream << GetId(EK_FACTION, party_template[4], name) << ' ';
 		stream << party_template[5] << ' ';
 
-		CPyObject members = party_template[6];
+		const DataNode &members = party_template[6];
 		int num_members = (int)members.Len();
 
 		if (num_members > 6)
@@ -1468,9 +2058,9 @@ void ModuleSystem::WritePartyTemplates()
 
 		for (int i = 0; i < num_members; ++i)
 		{
-			CPyObject member = members[i];
+			const DataNode &member = members[i];
 
-			stream << GetId("trp", member[0], name + ", member " + itostr(i)) << ' ';
+			stream << GetId(EK_TROOP, member[0], Join({ name, ", member ", itostr(i) })) << ' ';
 			stream << member[1] << ' ';
 			stream << member[2] << ' ';
 
@@ -1482,7 +2072,7 @@ void ModuleSystem::WritePartyTemplates()
 
 		for (int i = num_members; i < 6; ++i) stream << "-1 ";
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1490,23 +2080,20 @@ void ModuleSystem::WritePostEffects()
 {
 	PrepareModule("post effects");
 
-	std::ofstream stream(m_output_path + "postfx.txt");
-	CPyIter iter = m_postfx.GetIter();
+	OutputBuffer stream(m_output_path + "postfx.txt", m_writer);
 
-	stream << "postfx_paramsfile version 1" << std::endl;
-	stream << m_postfx.Size() << std::endl;
+	stream << "postfx_paramsfile version 1\n";
+	stream << m_postfx.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &effect : m_postfx)
 	{
-		CPyObject effect = iter.Next();
-
-		stream << "pfx_" << encode_id(effect[0].AsString()) << ' ';
+		stream << "pfx_" << EncodeId(effect[0].AsString()) << ' ';
 		stream << effect[1] << ' ';
 		stream << effect[2] << ' ';
 
 		for (int i = 0; i < 3; ++i)
 		{
-			CPyObject params = effect[i + 3];
+			const DataNode &params = effect[i + 3];
 
 			stream << params[0] << ' ';
 			stream << params[1] << ' ';
@@ -1514,7 +2101,7 @@ void ModuleSystem::WritePostEffects()
 			stream << params[3] << ' ';
 		}
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1522,21 +2109,19 @@ void ModuleSystem::WritePresentations()
 {
 	PrepareModule("presentations");
 
-	std::ofstream stream(m_output_path + "presentations.txt");
-	CPyIter iter = m_presentations.GetIter();
+	OutputBuffer stream(m_output_path + "presentations.txt", m_writer);
 
-	stream << "presentationsfile version 1" << std::endl;
-	stream << m_presentations.Size() << std::endl;
+	stream << "presentationsfile version 1\n";
+	stream << m_presentations.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &presentation : m_presentations)
 	{
-		CPyObject presentation = iter.Next();
-		std::string name = "prsnt_" + encode_id(presentation[0].AsString());
+		std::string_view name = EncodeId(presentation[0].AsString(), "prsnt_");
 
 		stream << name << ' ';
 		stream << presentation[1] << ' ';
-		stream << GetId("mesh", presentation[2], name) << ' ';
-		WriteSimpleTriggerBlock(presentation[3], stream, name);
+		stream << GetId(EK_MESH, presentation[2], name) << ' ';
+		WriteSimpleTriggerBlock(presentation[3], stream, Location(name));
 	}
 }
 
@@ -1544,21 +2129,18 @@ void ModuleSystem::WriteQuests()
 {
 	PrepareModule("quests");
 
-	std::ofstream stream(m_output_path + "quests.txt");
-	CPyIter iter = m_quests.GetIter();
+	OutputBuffer stream(m_output_path + "quests.txt", m_writer);
 
-	stream << "questsfile version 1" << std::endl;
-	stream << m_quests.Size() << std::endl;
+	stream << "questsfile version 1\n";
+	stream << m_quests.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &quest : m_quests)
 	{
-		CPyObject quest = iter.Next();
-
-		stream << "qst_" << encode_id(quest[0].AsString()) << ' ';
-		stream << encode_str(quest[1].AsString()) << ' ';
+		stream << "qst_" << EncodeId(quest[0].AsString()) << ' ';
+		stream << EncodeStr(quest[1].AsString()) << ' ';
 		stream << quest[2] << ' ';
-		stream << encode_str(quest[3].AsString()) << ' ';
-		stream << std::endl;
+		stream << EncodeStr(quest[3].AsString()) << ' ';
+		stream << '\n';
 	}
 }
 
@@ -1566,41 +2148,31 @@ void ModuleSystem::WriteQuickStrings()
 {
 	PrepareModule("quick strings");
 
-	std::ofstream stream(m_output_path + "quick_strings.txt");
-	std::vector<std::string> quick_strings(m_quick_strings.size());
+	OutputBuffer stream(m_output_path + "quick_strings.txt", m_writer);
+	stream << m_quick_strings.size() << '\n';
 
-	for (auto & quick_string : m_quick_strings) quick_strings[quick_string.second.index] = quick_string.first;
-
-	stream << quick_strings.size() << std::endl;
-
-	for (size_t i = 0; i < quick_strings.size(); ++i)
-	{
-		stream << quick_strings[i] << ' ';
-		stream << m_quick_strings[quick_strings[i]].value << std::endl;
-	}
+	for (const QuickString &quick_string : m_quick_strings) stream << quick_string.id << ' ' << quick_string.value << '\n';
 }
 
 void ModuleSystem::WriteSceneProps()
 {
 	PrepareModule("scene props");
 
-	std::ofstream stream(m_output_path + "scene_props.txt");
-	CPyIter iter = m_scene_props.GetIter();
+	OutputBuffer stream(m_output_path + "scene_props.txt", m_writer);
 
-	stream << "scene_propsfile version 1" << std::endl;
-	stream << m_scene_props.Size() << std::endl;
+	stream << "scene_propsfile version 1\n";
+	stream << m_scene_props.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &scene_prop : m_scene_props)
 	{
-		CPyObject scene_prop = iter.Next();
-		std::string name = "spr_" + encode_strip(scene_prop[0].AsString());
+		std::string_view name = Encode(scene_prop[0].AsString(), "spr_", ENC_FULL | ENC_TRIM);
 
 		stream << name << ' ';
 		stream << scene_prop[1] << ' ';
 		stream << (((unsigned long long)scene_prop[1].AsLong() >> 20) & 0xFF) << ' ';
 		stream << GetResource(scene_prop[2], RES_MESH, name) << ' ';
 		stream << GetResource(scene_prop[3], RES_BODY, name) << ' ';
-		WriteSimpleTriggerBlock(scene_prop[4], stream, name);
+		WriteSimpleTriggerBlock(scene_prop[4], stream, Location(name));
 	}
 }
 
@@ -1608,19 +2180,17 @@ void ModuleSystem::WriteScenes()
 {
 	PrepareModule("scenes");
 
-	std::ofstream stream(m_output_path + "scenes.txt");
-	CPyIter iter = m_scenes.GetIter();
+	OutputBuffer stream(m_output_path + "scenes.txt", m_writer);
 
-	stream << "scenesfile version 1" << std::endl;
-	stream << m_scenes.Size() << std::endl;
+	stream << "scenesfile version 1\n";
+	stream << m_scenes.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &scene : m_scenes)
 	{
-		CPyObject scene = iter.Next();
-		std::string name = "scn_" + encode_id(scene[0].AsString());
+		std::string_view name = EncodeId(scene[0].AsString(), "scn_");
 
 		stream << name << ' ';
-		stream << encode_str(scene[0].AsString()) << ' ';
+		stream << EncodeStr(scene[0].AsString()) << ' ';
 		stream << scene[1] << ' ';
 		stream << GetResource(scene[2], RES_MESH, name) << ' ';
 		stream << GetResource(scene[3], RES_BODY, name) << ' ';
@@ -1631,129 +2201,122 @@ void ModuleSystem::WriteScenes()
 		stream << scene[6] << ' ';
 		stream << scene[7] << ' ';
 
-		CPyObject passages = scene[8];
-		CPyIter passage_iter = passages.GetIter();
+		const DataNode &passages = scene[8];
 
 		stream << passages.Len() << ' ';
 
-		while (passage_iter.HasNext())
+		for (const DataNode &passage : passages)
 		{
-			CPyObject passage = passage_iter.Next();
 			int scene_id;
 
 			if (passage.IsLong())
 				scene_id = (long)passage.AsLong();
 			else
 			{
-				std::string name = passage.AsString();
+				std::string_view name = passage.AsString();
 
 				if (name.empty())
 					scene_id = 0;
 				else if (name == "exit")
 					scene_id = 100000;
 				else
-					scene_id = GetId("scn", passage, name);
+					scene_id = GetId(EK_SCENE, passage, name);
 			}
 
 			stream << scene_id << ' ';
 		}
 
-		CPyObject chests = scene[9];
-		CPyIter chest_iter = chests.GetIter();
+		const DataNode &chests = scene[9];
 
 		stream << chests.Len() << ' ';
 
-		while (chest_iter.HasNext()) stream << GetId("trp", chest_iter.Next(), name) << ' ';
+		for (const DataNode &chest : chests) stream << GetId(EK_TROOP, chest, name) << ' ';
 
 		if (scene.Len() > 10)
 			stream << scene[10] << ' ';
 		else
 			stream << "0 ";
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
 void ModuleSystem::WriteScripts()
 {
 	PrepareModule("scripts");
-	std::ofstream table_stream;
+	OutputBuffer table_stream(m_writer);
 
-	if (m_flags & MSF_OBFUSCATE_SCRIPTS && m_flags & MSF_LIST_OBFUSCATED_SCRIPTS) table_stream.open(m_output_path + "obfuscated_scripts.txt");
+	if (m_flags & MSF_OBFUSCATE_SCRIPTS && m_flags & MSF_LIST_OBFUSCATED_SCRIPTS) table_stream.Open(m_output_path + "obfuscated_scripts.txt");
 
-	std::ofstream stream(m_output_path + "scripts.txt");
-	CPyIter iter = m_scripts.GetIter();
-	int num_scripts = (int)m_scripts.Size();
+	OutputBuffer stream(m_output_path + "scripts.txt", m_writer);
+	int num_scripts = (int)m_scripts.Len();
 
-	stream << "scriptsfile version 1" << std::endl;
-	stream << num_scripts << std::endl;
+	stream << "scriptsfile version 1\n";
+	stream << num_scripts << '\n';
 
 	for (int i = 0; i < num_scripts; ++i)
 	{
-		CPyObject script = m_scripts[i];
-		std::string name = encode_id(script[0].AsString());
+		const DataNode &script = m_scripts[i];
+		std::string_view name = EncodeId(script[0].AsString());
 
-		if ((m_flags & MSF_OBFUSCATE_SCRIPTS) && name.substr(0, 5) != "game_" && name.substr(0, 4) != "wse_")
+		if ((m_flags & MSF_OBFUSCATE_SCRIPTS) && !is_engine_script(name))
 		{
-			if (m_flags & MSF_LIST_OBFUSCATED_SCRIPTS) table_stream << "script_" << i << "=" << name << std::endl;
+			if (m_flags & MSF_LIST_OBFUSCATED_SCRIPTS) table_stream << "script_" << i << "=" << name << '\n';
 
 			stream << "script_" << i << ' ';
 		}
 		else
 			stream << name << ' ';
 
-		CPyObject obj = script[1];
+		const DataNode &obj = script[1];
 		bool fails_at_zero;
 
 		if (obj.IsTuple() || obj.IsList())
 		{
 			stream << "-1 ";
-			fails_at_zero = WriteStatementBlock(obj, stream, name);
+			fails_at_zero = WriteStatementBlock(obj, stream, Location(name));
 		}
 		else
 		{
 			stream << obj << ' ';
-			fails_at_zero = WriteStatementBlock(script[2], stream, name);
+			fails_at_zero = WriteStatementBlock(script[2], stream, Location(name));
 		}
 
-		if (fails_at_zero && name.substr(0, 3) != "cf_") Warning(WL_WARNING, "non cf_ script can fail", name);
+		if (fails_at_zero && !has_prefix(name, can_fail_script_prefix)) Warning(WL_WARNING, "non cf_ script can fail", name);
 
-		stream << std::endl;
+		stream << '\n';
 	}
 
 	if (m_flags & MSF_LIST_OBFUSCATED_SCRIPTS)
-		table_stream.close();
+		table_stream.Close();
 }
 
 void ModuleSystem::WriteSimpleTriggers()
 {
 	PrepareModule("simple triggers");
 
-	std::ofstream stream(m_output_path + "simple_triggers.txt");
+	OutputBuffer stream(m_output_path + "simple_triggers.txt", m_writer);
 
-	stream << "simple_triggers_file version 1" << std::endl;
-	WriteSimpleTriggerBlock(m_simple_triggers, stream, "simple game triggers");
+	stream << "simple_triggers_file version 1\n";
+	WriteSimpleTriggerBlock(m_simple_triggers, stream, Location("simple game triggers"));
 }
 
 void ModuleSystem::WriteSkills()
 {
 	PrepareModule("skills");
 
-	std::ofstream stream(m_output_path + "skills.txt");
-	CPyIter iter = m_skills.GetIter();
+	OutputBuffer stream(m_output_path + "skills.txt", m_writer);
 
-	stream << m_skills.Size() << std::endl;
+	stream << m_skills.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &skill : m_skills)
 	{
-		CPyObject skill = iter.Next();
-
-		stream << "skl_" << encode_id(skill[0].AsString()) << ' ';
-		stream << encode_str(skill[1].AsString()) << ' ';
+		stream << "skl_" << EncodeId(skill[0].AsString()) << ' ';
+		stream << EncodeStr(skill[1].AsString()) << ' ';
 		stream << skill[2] << ' ';
 		stream << skill[3] << ' ';
-		stream << encode_str(skill[4].AsString()) << ' ';
-		stream << std::endl;
+		stream << EncodeStr(skill[4].AsString()) << ' ';
+		stream << '\n';
 	}
 }
 
@@ -1761,8 +2324,8 @@ void ModuleSystem::WriteSkins()
 {
 	PrepareModule("skins");
 
-	std::ofstream stream(m_output_path + "skins.txt");
-	int num_skins = (int)m_skins.Size();
+	OutputBuffer stream(m_output_path + "skins.txt", m_writer);
+	int num_skins = (int)m_skins.Len();
 
 	if (num_skins > 16)
 	{
@@ -1770,13 +2333,13 @@ void ModuleSystem::WriteSkins()
 		num_skins = 16;
 	}
 
-	stream << "skins_file version 1" << std::endl;
-	stream << num_skins << std::endl;
+	stream << "skins_file version 1\n";
+	stream << num_skins << '\n';
 
 	for (int i = 0; i < num_skins; ++i)
 	{
-		CPyObject skin = m_skins[i];
-		std::string name = encode_id(skin[0].AsString());
+		const DataNode &skin = m_skins[i];
+		std::string_view name = EncodeId(skin[0].AsString());
 
 		stream << name << ' ';
 		stream << skin[1] << ' ';
@@ -1785,65 +2348,55 @@ void ModuleSystem::WriteSkins()
 		stream << GetResource(skin[4], RES_MESH, name) << ' ';
 		stream << GetResource(skin[5], RES_MESH, name) << ' ';
 
-		CPyObject face_keys = skin[6];
-		CPyIter face_key_iter = face_keys.GetIter();
+		const DataNode &face_keys = skin[6];
 
 		stream << face_keys.Len() << ' ';
 
-		while (face_key_iter.HasNext())
+		for (const DataNode &face_key : face_keys)
 		{
-			CPyObject face_key = face_key_iter.Next();
-
-			stream << "skinkey_" << encode_id(face_key[4].AsString()) << ' ';
+			stream << "skinkey_" << EncodeId(face_key[4].AsString()) << ' ';
 			stream << face_key[0] << ' ';
 			stream << face_key[1] << ' ';
 			stream << face_key[2] << ' ';
 			stream << face_key[3] << ' ';
-			stream << encode_str(face_key[4].AsString()) << ' ';
+			stream << EncodeStr(face_key[4].AsString()) << ' ';
 		}
 
-		CPyObject hair_meshes = skin[7];
-		CPyIter hair_mesh_iter = hair_meshes.GetIter();
+		const DataNode &hair_meshes = skin[7];
 
 		stream << hair_meshes.Len() << ' ';
 
-		while (hair_mesh_iter.HasNext()) stream << GetResource(hair_mesh_iter.Next(), RES_MESH, name) << ' ';
+		for (const DataNode &hair_mesh : hair_meshes) stream << GetResource(hair_mesh, RES_MESH, name) << ' ';
 
-		CPyObject beard_meshes = skin[8];
-		CPyIter beard_mesh_iter = beard_meshes.GetIter();
+		const DataNode &beard_meshes = skin[8];
 
 		stream << beard_meshes.Len() << ' ';
 
-		while (beard_mesh_iter.HasNext()) stream << GetResource(beard_mesh_iter.Next(), RES_MESH, name) << ' ';
+		for (const DataNode &beard_mesh : beard_meshes) stream << GetResource(beard_mesh, RES_MESH, name) << ' ';
 
-		CPyObject hair_materials = skin[9];
-		CPyIter hair_material_iter = hair_materials.GetIter();
+		const DataNode &hair_materials = skin[9];
 
 		stream << hair_materials.Len() << ' ';
 
-		while (hair_material_iter.HasNext()) stream << GetResource(hair_material_iter.Next(), RES_MATERIAL, name) << ' ';
+		for (const DataNode &hair_material : hair_materials) stream << GetResource(hair_material, RES_MATERIAL, name) << ' ';
 
-		CPyObject beard_materials = skin[10];
-		CPyIter beard_material_iter = beard_materials.GetIter();
+		const DataNode &beard_materials = skin[10];
 
 		stream << beard_materials.Len() << ' ';
 
-		while (beard_material_iter.HasNext()) stream << GetResource(beard_material_iter.Next(), RES_MATERIAL, name) << ' ';
+		for (const DataNode &beard_material : beard_materials) stream << GetResource(beard_material, RES_MATERIAL, name) << ' ';
 
-		CPyObject face_textures = skin[11];
-		CPyIter face_texture_iter = face_textures.GetIter();
+		const DataNode &face_textures = skin[11];
 
 		stream << face_textures.Len() << ' ';
 
-		while (face_texture_iter.HasNext())
+		for (const DataNode &face_texture : face_textures)
 		{
-			CPyObject face_texture = face_texture_iter.Next();
-
 			stream << GetResource(face_texture[0], RES_MATERIAL, name) << ' ';
 			stream << face_texture[1] << ' ';
 
-			CPyObject hair_materials;
-			CPyObject hair_colors;
+			DataNode hair_materials;
+			DataNode hair_colors;
 			int num_hair_materials = 0;
 			int num_hair_colors = 0;
 
@@ -1867,43 +2420,37 @@ void ModuleSystem::WriteSkins()
 			for (int i = 0; i < num_hair_colors; ++i) stream << hair_colors[i] << ' ';
 		}
 
-		CPyObject voices = skin[12];
-		CPyIter voice_iter = voices.GetIter();
+		const DataNode &voices = skin[12];
 
 		stream << voices.Len() << ' ';
 
-		while (voice_iter.HasNext())
+		for (const DataNode &voice : voices)
 		{
-			CPyObject voice = voice_iter.Next();
-
 			stream << voice[0] << ' ';
-			stream << encode_id(voice[1].Str()) << ' ';
+			stream << EncodeId(voice[1].Str()) << ' ';
 		}
 
 		stream << GetResource(skin[13], RES_SKELETON, name) << ' ';
 		stream << skin[14] << ' ';
 
 		if (skin.Len() > 15)
-			stream << GetId("psys", skin[15], name) << ' ';
+			stream << GetId(EK_PARTICLE_SYSTEM, skin[15], name) << ' ';
 		else
 			stream << "0 ";
 
 		if (skin.Len() > 16)
-			stream << GetId("psys", skin[16], name) << ' ';
+			stream << GetId(EK_PARTICLE_SYSTEM, skin[16], name) << ' ';
 		else
 			stream << "0 ";
 
 		if (skin.Len() > 17)
 		{
-			CPyObject constraints = skin[17];
-			CPyIter constraint_iter = constraints.GetIter();
+			const DataNode &constraints = skin[17];
 
 			stream << constraints.Len() << ' ';
 
-			while (constraint_iter.HasNext())
+			for (const DataNode &constraint : constraints)
 			{
-				CPyObject constraint = constraint_iter.Next();
-
 				stream << constraint[0] << ' ';
 				stream << constraint[1] << ' ';
 
@@ -1913,7 +2460,7 @@ void ModuleSystem::WriteSkins()
 
 				for (int i = 0; i < num_pairs; ++i)
 				{
-					CPyObject pair = constraint[i + 2];
+					const DataNode &pair = constraint[i + 2];
 
 					stream << pair[0] << ' ';
 					stream << pair[1] << ' ';
@@ -1922,7 +2469,7 @@ void ModuleSystem::WriteSkins()
 		}
 		else stream << "0 ";
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1930,22 +2477,20 @@ void ModuleSystem::WriteSkyboxes()
 {
 	PrepareModule("skyboxes");
 
-	std::ofstream stream(m_output_path + "Data" + PATH_SEPARATOR + "skyboxes.txt");
-	CPyIter	iter = m_skyboxes.GetIter();
+	OutputBuffer stream(m_output_path + "Data" + PATH_SEPARATOR + "skyboxes.txt", m_writer);
 
-	stream << m_skyboxes.Size() << std::endl;
+	stream << m_skyboxes.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &skybox : m_skyboxes)
 	{
-		CPyObject skybox = iter.Next();
-		std::string name = encode_res(skybox[0].AsString());
+		std::string_view name = EncodeRes(skybox[0].AsString());
 
 		stream << GetResource(skybox[0], RES_MESH, name) << ' ';
 		stream << skybox[1] << ' ';
 		stream << skybox[2] << ' ';
 		stream << skybox[3] << ' ';
 		stream << skybox[4] << ' ';
-		stream << encode_id(skybox[5].AsString()) << ' ';
+		stream << EncodeId(skybox[5].AsString()) << ' ';
 		stream << skybox[6][0] << ' ';
 		stream << skybox[6][1] << ' ';
 		stream << skybox[6][2] << ' ';
@@ -1957,7 +2502,7 @@ void ModuleSystem::WriteSkyboxes()
 		stream << skybox[8][2] << ' ';
 		stream << skybox[9][0] << ' ';
 		stream << skybox[9][1] << ' ';
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -1965,22 +2510,18 @@ void ModuleSystem::WriteSounds()
 {
 	PrepareModule("sounds");
 
-	std::ofstream stream(m_output_path + "sounds.txt");
-	CPyIter iter = m_sounds.GetIter();
-	std::map<std::string, int> samples;
-	std::vector<std::string> samples_vec;
+	OutputBuffer stream(m_output_path + "sounds.txt", m_writer);
+	std::unordered_map<std::string_view, int> samples;
+	std::vector<std::string_view> samples_vec;
 	std::vector<unsigned long> sample_flags;
 
-	while (iter.HasNext())
+	for (const DataNode &sound : m_sounds)
 	{
-		CPyObject sound = iter.Next();
-		CPyObject sound_files = sound[2];
-		CPyIter sound_file_iter = sound_files.GetIter();
+		const DataNode &sound_files = sound[2];
 
-		while (sound_file_iter.HasNext())
+		for (const DataNode &sound_file : sound_files)
 		{
-			CPyObject sound_file = sound_file_iter.Next();
-			std::string file = sound_file.IsTuple() || sound_file.IsList() ? sound_file[0].AsString() : sound_file.AsString();
+			std::string_view file = sound_file.IsTuple() || sound_file.IsList() ? sound_file[0].AsString() : sound_file.AsString();
 
 			if (samples.find(file) == samples.end())
 			{
@@ -1991,29 +2532,27 @@ void ModuleSystem::WriteSounds()
 		}
 	}
 
-	stream << "soundsfile version 3" << std::endl;
-	stream << samples_vec.size() << std::endl;
+	stream << "soundsfile version 3\n";
+	stream << samples_vec.size() << '\n';
 
 	for (size_t i = 0; i < samples_vec.size(); ++i)
 	{
 		stream << samples_vec[i] << ' ';
 		stream << sample_flags[i] << ' ';
-		stream << std::endl;
+		stream << '\n';
 	}
 
-	iter = m_sounds.GetIter();
-	stream << std::endl;
-	stream << m_sounds.Size() << std::endl;
+	stream << '\n';
+	stream << m_sounds.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &sound : m_sounds)
 	{
-		CPyObject sound = iter.Next();
-		std::string name = "snd_" + encode_id(sound[0].AsString());
+		std::string_view name = EncodeId(sound[0].AsString(), "snd_");
 
 		stream << name << ' ';
 		stream << sound[1] << ' ';
 
-		CPyObject sound_files = sound[2];
+		const DataNode &sound_files = sound[2];
 		int num_samples = (int)sound_files.Len();
 
 		stream << num_samples << ' ';
@@ -2026,8 +2565,8 @@ void ModuleSystem::WriteSounds()
 
 		for (int i = 0; i < num_samples; ++i)
 		{
-			CPyObject sound_file = sound_files[i];
-			std::string file;
+			const DataNode &sound_file = sound_files[i];
+			std::string_view file;
 			unsigned long flags;
 
 			if (sound_file.IsTuple() || sound_file.IsList())
@@ -2044,7 +2583,7 @@ void ModuleSystem::WriteSounds()
 			stream << samples[file] << ' ';
 			stream << flags << ' ';
 		}
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
@@ -2052,19 +2591,16 @@ void ModuleSystem::WriteStrings()
 {
 	PrepareModule("strings");
 
-	std::ofstream stream(m_output_path + "strings.txt");
-	CPyIter iter = m_strings.GetIter();
+	OutputBuffer stream(m_output_path + "strings.txt", m_writer);
 
-	stream << "stringsfile version 1" << std::endl;
-	stream << m_strings.Size() << std::endl;
+	stream << "stringsfile version 1\n";
+	stream << m_strings.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &string : m_strings)
 	{
-		CPyObject string = iter.Next();
-
-		stream << "str_" << encode_id(string[0].AsString()) << ' ';
-		stream << encode_str(string[1].AsString()) << ' ';
-		stream << std::endl;
+		stream << "str_" << EncodeId(string[0].AsString()) << ' ';
+		stream << EncodeStr(string[1].AsString()) << ' ';
+		stream << '\n';
 	}
 }
 
@@ -2072,27 +2608,25 @@ void ModuleSystem::WriteTableaus()
 {
 	PrepareModule("tableau materials");
 
-	std::ofstream stream(m_output_path + "tableau_materials.txt");
-	CPyIter iter = m_tableau_materials.GetIter();
+	OutputBuffer stream(m_output_path + "tableau_materials.txt", m_writer);
 
-	stream << m_tableau_materials.Size() << std::endl;
+	stream << m_tableau_materials.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &tableau : m_tableau_materials)
 	{
-		CPyObject tableau = iter.Next();
-		std::string name = "tab_" + encode_id(tableau[0].AsString());
+		std::string_view name = EncodeId(tableau[0].AsString(), "tab_");
 
 		stream << name << ' ';
 		stream << tableau[1] << ' ';
-		stream << GetResource(tableau[2].AsString(), RES_MATERIAL, name) << ' ';
+		stream << GetResource(tableau[2], RES_MATERIAL, name) << ' ';
 		stream << tableau[3] << ' ';
 		stream << tableau[4] << ' ';
 		stream << tableau[5] << ' ';
 		stream << tableau[6] << ' ';
 		stream << tableau[7] << ' ';
 		stream << tableau[8] << ' ';
-		WriteStatementBlock(tableau[9], stream, name);
-		stream << std::endl;
+		WriteStatementBlock(tableau[9], stream, Location(name));
+		stream << '\n';
 	}
 }
 
@@ -2100,40 +2634,38 @@ void ModuleSystem::WriteTriggers()
 {
 	PrepareModule("triggers");
 
-	std::ofstream stream(m_output_path + "triggers.txt");
+	OutputBuffer stream(m_output_path + "triggers.txt", m_writer);
 
-	stream << "triggersfile version 1" << std::endl;
-	WriteTriggerBlock(m_triggers, stream, "game triggers");
+	stream << "triggersfile version 1\n";
+	WriteTriggerBlock(m_triggers, stream, Location("game triggers"));
 }
 
 void ModuleSystem::WriteTroops()
 {
 	PrepareModule("troops");
 
-	std::ofstream stream(m_output_path + "troops.txt");
-	CPyIter iter = m_troops.GetIter();
+	OutputBuffer stream(m_output_path + "troops.txt", m_writer);
 
-	stream << "troopsfile version 2" << std::endl;
-	stream << m_troops.Size() << std::endl;
+	stream << "troopsfile version 2\n";
+	stream << m_troops.Len() << '\n';
 
-	while (iter.HasNext())
+	for (const DataNode &troop : m_troops)
 	{
-		CPyObject troop = iter.Next();
-		std::string name = "trp_" + encode_id(troop[0].AsString());
+		std::string_view name = EncodeId(troop[0].AsString(), "trp_");
 
 		stream << name << ' ';
-		stream << encode_str(troop[1].AsString()) << ' ';
-		stream << encode_str(troop[2].AsString()) << ' ';
+		stream << EncodeStr(troop[1].AsString()) << ' ';
+		stream << EncodeStr(troop[2].AsString()) << ' ';
 
 		if (troop.Len() > 13)
-			stream << GetResource(troop[13].Str(), RES_MESH, name) << ' ';
+			stream << GetResource(troop[13].Str(), RES_MESH) << ' ';
 		else
 			stream << "0 ";
 
 		stream << troop[3] << ' ';
 		stream << troop[4] << ' ';
 		stream << troop[5] << ' ';
-		stream << GetId("fac", troop[6], name) << ' ';
+		stream << GetId(EK_FACTION, troop[6], name) << ' ';
 
 		if (troop.Len() > 14)
 			stream << troop[14] << ' ';
@@ -2145,20 +2677,20 @@ void ModuleSystem::WriteTroops()
 		else
 			stream << "0 ";
 
-		CPyObject items = troop[7];
+		const DataNode &items = troop[7];
 		int num_items = (int)items.Len();
 
 		for (int i = 0; i < num_items; ++i)
 		{
 			if (items[i].IsTuple() || items[i].IsList())
-				stream << GetId("itm", items[i][0], name) << ' ' << ((long)items[i][1].AsLong() << 24) << ' ';
+				stream << GetId(EK_ITEM, items[i][0], name) << ' ' << ((long)items[i][1].AsLong() << 24) << ' ';
 			else
-				stream << GetId("itm", items[i], name) << " 0 ";
+				stream << GetId(EK_ITEM, items[i], name) << " 0 ";
 		}
 
 		for (int i = num_items; i < 64; ++i) stream << "-1 0 ";
 
-		CPyNumber attribs = troop[8];
+		WideInt attribs = troop[8].AsNumber();
 
 		stream << ((attribs >> 0) & 0xFF) << ' ';
 		stream << ((attribs >> 8) & 0xFF) << ' ';
@@ -2166,7 +2698,7 @@ void ModuleSystem::WriteTroops()
 		stream << ((attribs >> 24) & 0xFF) << ' ';
 		stream << ((attribs >> 32) & 0xFF) << ' ';
 
-		CPyNumber proficiencies = troop[9].AsNumber();
+		WideInt proficiencies = troop[9].AsNumber();
 
 		for (int i = 0; i < 7; ++i)
 		{
@@ -2174,90 +2706,113 @@ void ModuleSystem::WriteTroops()
 			proficiencies = proficiencies >> 10;
 		}
 
-		CPyNumber skills = troop[10].AsNumber();
+		WideInt skills = troop[10].AsNumber();
 
 		for (int i = 0; i < 6; ++i) stream << ((skills >> (i * 32)) & 0xFFFFFFFF) << ' ';
 
 		for (int i = 0; i < 2; ++i)
 		{
-			CPyNumber face_key;
+			WideInt face_key;
 
 			if (troop.Len() > i + 11) face_key = troop[i + 11].AsNumber();
 
 			for (int j = 0; j < 4; ++j) stream << ((face_key >> ((3 - j) * 64)) & 0xFFFFFFFFFFFFFFFF) << ' ';
 		}
 
-		stream << std::endl;
+		stream << '\n';
 	}
 }
 
-void ModuleSystem::WriteSimpleTriggerBlock(const CPyObject &simple_trigger_block, std::ostream &stream, const std::string &context)
+void ModuleSystem::WriteSimpleTriggerBlock(const DataNode &simple_trigger_block, OutputBuffer &stream, const Location &location)
 {
 	int num_simple_triggers = (int)simple_trigger_block.Len();
+	Location simple_trigger_location = location;
 
-	stream << num_simple_triggers << std::endl;
+	stream << num_simple_triggers << '\n';
+	simple_trigger_location.trigger_type = LOC_SIMPLE_TRIGGER;
 
 	for (int i = 0; i < num_simple_triggers; ++i)
 	{
-		WriteSimpleTrigger(simple_trigger_block[i], stream, context + ", simple trigger " + itostr(i));
-		stream << std::endl;
+		simple_trigger_location.trigger = i;
+		WriteSimpleTrigger(simple_trigger_block[i], stream, simple_trigger_location);
+		stream << '\n';
 	}
 }
 
-void ModuleSystem::WriteSimpleTrigger(const CPyObject &simple_trigger, std::ostream &stream, const std::string &context)
+void ModuleSystem::WriteSimpleTrigger(const DataNode &simple_trigger, OutputBuffer &stream, const Location &location)
 {
 	stream << simple_trigger[0] << ' ';
-	WriteStatementBlock(simple_trigger[1], stream, context);
+	WriteStatementBlock(simple_trigger[1], stream, location);
 }
 
-void ModuleSystem::WriteTriggerBlock(const CPyObject &trigger_block, std::ostream &stream, const std::string &context)
+void ModuleSystem::WriteTriggerBlock(const DataNode &trigger_block, OutputBuffer &stream, const Location &location)
 {
 	int num_triggers = (int)trigger_block.Len();
+	Location trigger_location = location;
 
-	stream << num_triggers << std::endl;
+	stream << num_triggers << '\n';
+	trigger_location.trigger_type = LOC_TRIGGER;
 
 	for (int i = 0; i < num_triggers; ++i)
 	{
-		WriteTrigger(trigger_block[i], stream, context + ", trigger " + itostr(i));
-		stream << std::endl;
+		trigger_location.trigger = i;
+		WriteTrigger(trigger_block[i], stream, trigger_location);
+		stream << '\n';
 	}
 }
 
-void ModuleSystem::WriteTrigger(const CPyObject &trigger, std::ostream &stream, const std::string &context)
+void ModuleSystem::WriteTrigger(const DataNode &trigger, OutputBuffer &stream, const Location &location)
 {
+	Location block_location = location;
+
 	stream << trigger[0] << ' ';
 	stream << trigger[1] << ' ';
 	stream << trigger[2] << ' ';
-	WriteStatementBlock(trigger[3], stream, context + ", conditions");
-	WriteStatementBlock(trigger[4], stream, context + ", consequences");
+	block_location.block = LOC_CONDITIONS;
+	WriteStatementBlock(trigger[3], stream, block_location);
+	block_location.block = LOC_CONSEQUENCES;
+	WriteStatementBlock(trigger[4], stream, block_location);
 }
 
-bool ModuleSystem::WriteStatementBlock(const CPyObject &statement_block, std::ostream &stream, const std::string &context)
+bool ModuleSystem::WriteStatementBlock(const DataNode &statement_block, OutputBuffer &stream, const Location &location)
 {
 	int depth = 0;
 	bool fails_at_zero = false;
 	int num_statements = (int)statement_block.Len();
 
-	m_local_vars.clear();
+	m_local_var_generation++;
+	m_num_local_vars = 0;
+	m_local_vars_exceeded = false;
+	m_local_var_names.Reset();
 	stream << num_statements << ' ';
-	m_cur_context = context;
+	m_cur_location = location;
+
+	for (m_cur_location.statement = 0; m_cur_location.statement < num_statements; ++m_cur_location.statement) WriteStatement(statement_block[m_cur_location.statement], stream, depth, fails_at_zero);
 
-	for (m_cur_statement = 0; m_cur_statement < num_statements; ++m_cur_statement) WriteStatement(statement_block[m_cur_statement], stream, depth, fails_at_zero);
+	if (depth != 0) Warning(WL_ERROR, "unexpected try block depth " + itostr(depth), location);
 
-	if (depth != 0) Warning(WL_ERROR, "unexpected try block depth " + itostr(depth), context);
+	std::vector<std::string_view> unused_vars;
 
-	for (auto & var : m_local_vars)
+	for (int i = 0; i < m_num_local_vars; ++i)
 	{
-		if (var.second.usages == 0 && var.first.substr(0, 6) != "unused") Warning(WL_WARNING, "unused local variable :" + var.first, context);
+		const LocalVariable &var = m_local_vars[m_local_var_slots[i]];
+
+		if (var.usages == 0 && var.name.substr(0, 6) != "unused") unused_vars.push_back(var.name);
 	}
 
+	std::sort(unused_vars.begin(), unused_vars.end());
+
+	for (std::string_view name : unused_vars) Warning(WL_WARNING, "unused local variable :" + std::string(name), location);
+
 	return fails_at_zero;
 }
 
-void ModuleSystem::WriteStatement(const CPyObject &statement, std::ostream &stream, int &depth, bool &fails_at_zero)
+void ModuleSystem::WriteStatement(const DataNode &statement, OutputBuffer &stream, int &depth, bool &fails_at_zero)
 {
 	long long opcode = -1;
 
+	m_num_statements++;
+
 	if (statement.IsTuple() || statement.IsList())
 	{
 		int num_operands = (int)statement.Len() - 1;
@@ -2267,7 +2822,7 @@ void ModuleSystem::WriteStatement(const CPyObject &statement, std::ostream &stre
 
 		if (num_operands > 16)
 		{
-			Warning(WL_WARNING, "operand count exceeds 16", m_cur_context + ", statement " + itostr(m_cur_statement));
+			Warning(WL_WARNING, "operand count exceeds 16", m_cur_location);
 			num_operands = 16;
 		}
 
@@ -2281,11 +2836,13 @@ void ModuleSystem::WriteStatement(const CPyObject &statement, std::ostream &stre
 		stream << opcode << " 0 ";
 	}
 	else
-		Warning(WL_CRITICAL, "unrecognized statement type " + (std::string)statement.Type().Str(), m_cur_context + ", statement " + itostr(m_cur_statement));
+		Warning(WL_CRITICAL, "unrecognized statement type " + std::string(statement.TypeName()), m_cur_location);
 
 	int operation = opcode & 0xFFFFFFF;
 
-	depth += m_operation_depths[operation];
+	const OperationDescriptor &descriptor = m_operations.Get(operation);
+
+	depth += descriptor.depth;
 
-	if (depth == 0 && m_operations[operation] & OPTYPE_CF) fails_at_zero = true;
+	if (depth == 0 && descriptor.flags & OPTYPE_CF) fails_at_zero = true;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "CPyObject.h"
+#include "marshal.h"
 #if defined _WIN32
 #include <Windows.h>
 #else
@@ -10,11 +11,28 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <initializer_list>
 #include <map>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include "AllocationCounter.h"
+#include "EntityKinds.h"
+#include "MappedFile.h"
+#include "ModuleData.h"
+#include "OperationTable.h"
+#include "OutputBuffer.h"
 #include "StringUtils.h"
+#include "SymbolTable.h"
 
 #if defined _WIN32
 #define COLOR_RED (FOREGROUND_RED | FOREGROUND_INTENSITY)
@@ -42,34 +60,59 @@ struct ScriptErrorContext
 
 struct Variable
 {
-	int index;
+	std::string_view name;
 	int usages;
 	int assignments;
 	bool compat;
 };
 
-struct QuickString
+struct LocalVariable
 {
+	std::string_view name;
+	unsigned int generation;
 	int index;
-	std::string value;
+	int usages;
+	int assignments;
 };
 
-class CompileException
+struct QuickString
 {
-public:
-	explicit CompileException(const std::string &error) : m_error(error) { }
+	std::string_view id;
+	std::string_view value;
+};
 
-	const std::string &GetText() const
+struct CachedOperand
+{
+	const char *key;
+	unsigned long long value;
+	int symbol;
+	int global_var;
+};
+
+#define LOC_NONE           0
+#define LOC_SIMPLE_TRIGGER 1
+#define LOC_TRIGGER        2
+#define LOC_CONDITIONS     3
+#define LOC_CONSEQUENCES   4
+
+struct Location
+{
+	explicit Location(std::string_view entity, std::string_view item = std::string_view(), int block = LOC_NONE) : entity(entity), item(item), trigger_type(LOC_NONE), trigger(0), block(block), statement(-1)
 	{
-		return m_error;
 	}
 
-private:
-	std::string m_error;
+	std::string_view entity;
+	std::string_view item;
+	int trigger_type;
+	int trigger;
+	int block;
+	int statement;
 };
 
+#define MAX_NUM_LOCAL_VARS   128
+#define NUM_LOCAL_VAR_SLOTS  256
+
 #define OPCODE(obj) (((unsigned long long)obj) & 0xFFFFFFF)
-#define MAX_NUM_OPCODES 8192
 #define OPTYPE_LHS 0x1
 #define OPTYPE_GHS 0x2
 #define OPTYPE_CF  0x4
@@ -96,6 +139,13 @@ private:
 #define MSF_LIST_UNREFERENCED_SCRIPTS    0x200
 #define MSF_DISABLE_WARNINGS    0x400
 #define MSF_RUSMOD_REBALANSER    0x800
+#define MSF_SINGLE_INTERPRETER   0x1000
+#define MSF_ISOLATED_PYTHON      0x2000
+#define MSF_PARALLEL_IMPORT      0x4000
+#define MSF_BYTECODE_CACHE       0x8000
+#define MSF_PREWARM              0x10000
+#define MSF_LIST_UNREFERENCED    0x20000
+#define MSF_STATISTICS           0x40000
 
 #define WL_WARNING  0
 #define WL_ERROR    1
@@ -106,23 +156,50 @@ class ModuleSystem
 public:
 	ModuleSystem(const std::string &in_path, const std::string &out_path);
 	~ModuleSystem();
-	void Compile(unsigned long long flags = 0);
+	void SetCachePath(const std::string &cache_path);
+	bool Compile(unsigned long long flags = 0);
 
 private:
 	void LoadPythonInterpreter();
 	void UnloadPythonInterpreter();
+	void AppendModulePath();
+	void ConfigureBytecodeCache();
+	void CompileBytecode(const std::string &path, bool force);
+	void RefreshBytecodeCache();
+	void InstallImportHook();
+	void RemoveImportHook();
+	void InstallIdModule(const std::string &name, const std::string &prefix, const std::vector<std::string> &ids);
+	void ReloadStaleModules();
+	static PyObject *ImportHook(PyObject *self, PyObject *args, PyObject *kwargs);
 	void SetConsoleColor(int color);
 	void ResetConsoleColor();
 	void DoCompile();
-	CPyList AddModule(const std::string &module_name, const std::string &list_name, const std::string &prefix, const std::string &id_name, const std::string &id_prefix, int tag = -1);
-	CPyList AddModule(const std::string &module_name, const std::string &list_name, const std::string &prefix, int tag = -1);
-	CPyList AddModule(const std::string &module_name, const std::string &prefix, int tag = -1);
-	int GetId(const std::string &type, const CPyObject &obj, const std::string &context);
-	unsigned long long GetOperandId(const CPyObject &obj, const std::string &context);
-	std::string GetResource(const CPyObject &obj, int resource_type, const std::string &context);
-	long long ParseOperand(const CPyObject &statement, int pos);
+	void LoadModules();
+	void ImportModulesParallel();
+	DataNode ImportModule(const std::string &module_name, const std::string &list_name);
+	DataNode AddModule(int kind);
+	int GetId(int kind, const DataNode &obj, std::string_view context);
+	unsigned long long GetOperandId(const DataNode &obj, const Location &location, bool cache = false);
+	std::string_view GetResource(std::string_view name, int resource_type);
+	std::string_view GetResource(const DataNode &obj, int resource_type, std::string_view context);
+	std::string_view Encode(std::string_view str, std::string_view prefix, int encoding);
+	std::string_view EncodeStr(std::string_view str);
+	std::string_view EncodeRes(std::string_view str);
+	std::string_view EncodeFull(std::string_view str);
+	std::string_view EncodeStrip(std::string_view str);
+	std::string_view EncodeId(std::string_view str, std::string_view prefix = std::string_view());
+	std::string_view Join(std::initializer_list<std::string_view> parts);
+	long long ParseOperand(const DataNode &statement, int pos);
+	int AddQuickString(std::string_view text);
+	LocalVariable *FindLocalVariable(std::string_view name);
+	CachedOperand &FindCachedOperand(const char *key);
+	void CacheOperand(const CachedOperand &operand);
+	void LoadOperations();
+	int AddGlobalVariable(std::string_view name, bool compat);
+	void LoadCompatGlobalVariables(const std::string &path);
 	static void PrepareModule(const std::string &name);
-	void Warning(int level, const std::string &text, const std::string &context = "");
+	void Warning(int level, const std::string &text, std::string_view context = std::string_view());
+	void Warning(int level, const std::string &text, const Location &location);
 	void WriteAnimations();
 	void WriteDialogs();
 	void WriteFactions();
@@ -155,59 +232,81 @@ private:
 	void WriteTableaus();
 	void WriteTriggers();
 	void WriteTroops();
-	void WriteSimpleTriggerBlock(const CPyObject &simple_trigger_block, std::ostream &stream, const std::string &context);
-	void WriteSimpleTrigger(const CPyObject &simple_trigger, std::ostream &stream, const std::string &context);
-	void WriteTriggerBlock(const CPyObject &trigger_block, std::ostream &stream, const std::string &context);
-	void WriteTrigger(const CPyObject &trigger, std::ostream &stream, const std::string &context);
-	bool WriteStatementBlock(const CPyObject &statement_block, std::ostream &stream, const std::string &context);
-	void WriteStatement(const CPyObject &statement, std::ostream &stream, int &depth, bool &fails_at_zero);
+	void WriteSimpleTriggerBlock(const DataNode &simple_trigger_block, OutputBuffer &stream, const Location &location);
+	void WriteSimpleTrigger(const DataNode &simple_trigger, OutputBuffer &stream, const Location &location);
+	void WriteTriggerBlock(const DataNode &trigger_block, OutputBuffer &stream, const Location &location);
+	void WriteTrigger(const DataNode &trigger, OutputBuffer &stream, const Location &location);
+	bool WriteStatementBlock(const DataNode &statement_block, OutputBuffer &stream, const Location &location);
+	void WriteStatement(const DataNode &statement, OutputBuffer &stream, int &depth, bool &fails_at_zero);
 
 	int m_pass;
 	std::string m_input_path;
 	std::string m_output_path;
+	std::string m_cache_path;
 	unsigned long long m_flags;
-	std::map<std::string, unsigned long long> m_tags;
-	std::map<std::string, std::map<std::string, int>> m_ids;
-	std::map<std::string, std::map<std::string, int>> m_uses;
-	CPyList m_animations;
-	CPyList m_dialogs;
-	CPyList m_factions;
-	CPyList m_flora_kinds;
-	CPyList m_game_menus;
-	CPyList m_ground_specs;
-	CPyList m_info_pages;
-	CPyList m_items;
-	CPyList m_map_icons;
-	CPyList m_meshes;
-	CPyList m_music;
-	CPyList m_mission_templates;
-	CPyList m_particle_systems;
-	CPyList m_parties;
-	CPyList m_party_templates;
-	CPyList m_postfx;
-	CPyList m_presentations;
-	CPyList m_quests;
-	CPyList m_scene_props;
-	CPyList m_scenes;
-	CPyList m_scripts;
-	CPyList m_simple_triggers;
-	CPyList m_skills;
-	CPyList m_skins;
-	CPyList m_skyboxes;
-	CPyList m_sounds;
-	CPyList m_strings;
-	CPyList m_tableau_materials;
-	CPyList m_triggers;
-	CPyList m_troops;
-	unsigned int m_operations[MAX_NUM_OPCODES];
-	int m_operation_depths[MAX_NUM_OPCODES];
-	std::map<std::string, Variable> m_global_vars;
-	std::map<std::string, Variable> m_local_vars;
-	std::map<std::string, QuickString> m_quick_strings;
-	std::map<int, std::map<std::string, int>> m_resources;
+	SymbolTable m_symbols;
+	DataNode m_animations;
+	DataNode m_dialogs;
+	DataNode m_factions;
+	DataNode m_flora_kinds;
+	DataNode m_game_menus;
+	DataNode m_ground_specs;
+	DataNode m_info_pages;
+	DataNode m_items;
+	DataNode m_map_icons;
+	DataNode m_meshes;
+	DataNode m_music;
+	DataNode m_mission_templates;
+	DataNode m_particle_systems;
+	DataNode m_parties;
+	DataNode m_party_templates;
+	DataNode m_postfx;
+	DataNode m_presentations;
+	DataNode m_quests;
+	DataNode m_scene_props;
+	DataNode m_scenes;
+	DataNode m_scripts;
+	DataNode m_simple_triggers;
+	DataNode m_skills;
+	DataNode m_skins;
+	DataNode m_skyboxes;
+	DataNode m_sounds;
+	DataNode m_strings;
+	DataNode m_tableau_materials;
+	DataNode m_triggers;
+	DataNode m_troops;
+	DataSnapshot m_snapshot;
+	Arena m_text;
+	OutputWriter m_writer;
+	bool m_collect_modules;
+	std::vector<std::pair<std::string, std::string>> m_module_requests;
+	std::map<std::string, DataNode> m_prefetched_modules;
+	OperationTable m_operations;
+	std::vector<Variable> m_global_vars;
+	std::unordered_map<std::string_view, int> m_global_var_ids;
+	std::vector<LocalVariable> m_local_vars;
+	std::vector<int> m_local_var_slots;
+	int m_num_local_vars;
+	unsigned int m_local_var_generation;
+	bool m_local_vars_exceeded;
+	Arena m_local_var_names;
+	std::deque<QuickString> m_quick_strings;
+	std::unordered_map<std::string_view, int> m_quick_string_ids;
+	std::unordered_map<std::string_view, int> m_quick_string_texts;
+	std::unordered_map<std::string_view, int> m_quick_string_suffixes;
+	std::string m_quick_string_buffer;
+	std::vector<CachedOperand> m_operand_cache;
+	size_t m_num_cached_operands;
+	std::map<int, std::map<std::string_view, int>> m_resources;
 	std::map<std::string, bool> m_referencedScripts;
-	std::string m_cur_context;
-	int m_cur_statement;
+	Location m_cur_location;
+	PyObject *m_builtin_import;
+	size_t m_num_statements;
+	size_t m_write_allocations;
+	std::set<std::string> m_fresh_id_modules;
+	std::set<std::string> m_stale_modules;
+	std::map<std::string, std::set<std::string>> m_module_imports;
+	std::vector<std::string> m_module_order;
 #if defined _WIN32
 	CONSOLE_SCREEN_BUFFER_INFO m_console_info;
 	HANDLE m_console_handle;
@@ -0,0 +1,146 @@
+#include "OperationTable.h"
+#include <algorithm>
+#include <fstream>
+
+#define EMPTY_OPCODE 0xFFFFFFFF
+#define CACHE_VERSION 1
+
+static const OperationDescriptor empty_descriptor = { 0, 0 };
+
+OperationTable::OperationTable() : m_direct(NUM_DIRECT_OPCODES), m_sparse_opcodes(64, EMPTY_OPCODE), m_sparse(64), m_num_sparse(0)
+{
+}
+
+void OperationTable::Clear()
+{
+	std::fill(m_direct.begin(), m_direct.end(), empty_descriptor);
+	std::fill(m_sparse_opcodes.begin(), m_sparse_opcodes.end(), EMPTY_OPCODE);
+	m_num_sparse = 0;
+}
+
+void OperationTable::AddFlags(unsigned int opcode, unsigned int flags)
+{
+	Insert(opcode).flags |= flags;
+}
+
+void OperationTable::SetDepth(unsigned int opcode, int depth)
+{
+	Insert(opcode).depth = depth;
+}
+
+const OperationDescriptor &OperationTable::Get(unsigned int opcode) const
+{
+	if (opcode < NUM_DIRECT_OPCODES) return m_direct[opcode];
+
+	size_t mask = m_sparse_opcodes.size() - 1;
+
+	for (size_t slot = (opcode * 2654435761u) & mask; m_sparse_opcodes[slot] != EMPTY_OPCODE; slot = (slot + 1) & mask)
+	{
+		if (m_sparse_opcodes[slot] == opcode) return m_sparse[slot];
+	}
+
+	return empty_descriptor;
+}
+
+// The cache only holds the flags read from header_operations, block depths are set by the compiler itself
+bool OperationTable::Load(const std::string &path, unsigned long long source_hash)
+{
+	std::ifstream stream(path);
+	std::string magic;
+	int version = 0;
+	unsigned long long hash = 0;
+	size_t count = 0;
+
+	stream >> magic >> version >> hash >> count;
+
+	if (!stream || magic != "opcodes" || version != CACHE_VERSION || hash != source_hash) return false;
+
+	std::vector<std::pair<unsigned int, unsigned int>> entries(count);
+
+	for (auto &entry : entries) stream >> entry.first >> entry.second;
+
+	if (!stream) return false;
+
+	for (auto &entry : entries) AddFlags(entry.first, entry.second);
+
+	return true;
+}
+
+bool OperationTable::Save(const std::string &path, unsigned long long source_hash) const
+{
+	std::vector<std::pair<unsigned int, unsigned int>> entries;
+
+	for (unsigned int i = 0; i < NUM_DIRECT_OPCODES; ++i)
+	{
+		if (m_direct[i].flags) entries.push_back({ i, m_direct[i].flags });
+	}
+
+	for (size_t i = 0; i < m_sparse.size(); ++i)
+	{
+		if (m_sparse_opcodes[i] != EMPTY_OPCODE && m_sparse[i].flags) entries.push_back({ m_sparse_opcodes[i], m_sparse[i].flags });
+	}
+
+	std::ofstream stream(path);
+
+	stream << "opcodes " << CACHE_VERSION << ' ' << source_hash << ' ' << entries.size() << std::endl;
+
+	for (auto &entry : entries) stream << entry.first << ' ' << entry.second << std::endl;
+
+	return (bool)stream;
+}
+
+unsigned long long OperationTable::Hash(std::string_view data)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+
+	for (char c : data) hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+
+	return hash;
+}
+
+OperationDescriptor &OperationTable::Insert(unsigned int opcode)
+{
+	if (opcode < NUM_DIRECT_OPCODES) return m_direct[opcode];
+
+	size_t mask = m_sparse_opcodes.size() - 1;
+	size_t slot = (opcode * 2654435761u) & mask;
+
+	while (m_sparse_opcodes[slot] != EMPTY_OPCODE && m_sparse_opcodes[slot] != opcode) slot = (slot + 1) & mask;
+
+	if (m_sparse_opcodes[slot] == EMPTY_OPCODE)
+	{
+		if ((m_num_sparse + 1) * 2 > m_sparse_opcodes.size())
+		{
+			Grow();
+			return Insert(opcode);
+		}
+
+		m_sparse_opcodes[slot] = opcode;
+		m_sparse[slot] = empty_descriptor;
+		m_num_sparse++;
+	}
+
+	return m_sparse[slot];
+}
+
+void OperationTable::Grow()
+{
+	std::vector<unsigned int> opcodes(m_sparse_opcodes.size() * 2, EMPTY_OPCODE);
+	std::vector<OperationDescriptor> descriptors(opcodes.size());
+	size_t mask = opcodes.size() - 1;
+
+	for (size_t i = 0; i < m_sparse_opcodes.size(); ++i)
+	{
+		if (m_sparse_opcodes[i] == EMPTY_OPCODE) continue;
+
+		size_t slot = (m_sparse_opcodes[i] * 2654435761u) & mask;
+
+		while (opcodes[slot] != EMPTY_OPCODE) slot = (slot + 1) & mask;
+
+		opcodes[slot] = m_sparse_opcodes[i];
+		descriptors[slot] = m_sparse[i];
+	}
+
+	m_sparse_opcodes.swap(opcodes);
+	m_sparse.swap(descriptors);
+}
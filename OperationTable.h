@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define NUM_DIRECT_OPCODES 8192
+
+struct OperationDescriptor
+{
+	unsigned int flags;
+	int depth;
+};
+
+class OperationTable
+{
+public:
+	OperationTable();
+	void Clear();
+	void AddFlags(unsigned int opcode, unsigned int flags);
+	void SetDepth(unsigned int opcode, int depth);
+	const OperationDescriptor &Get(unsigned int opcode) const;
+	bool Load(const std::string &path, unsigned long long source_hash);
+	bool Save(const std::string &path, unsigned long long source_hash) const;
+	static unsigned long long Hash(std::string_view data);
+
+private:
+	OperationDescriptor &Insert(unsigned int opcode);
+	void Grow();
+
+	std::vector<OperationDescriptor> m_direct;
+	std::vector<unsigned int> m_sparse_opcodes;
+	std::vector<OperationDescriptor> m_sparse;
+	size_t m_num_sparse;
+};
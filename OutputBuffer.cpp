@@ -0,0 +1,278 @@
+#include "OutputBuffer.h"
+#if defined _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include "MappedFile.h"
+#include "StringUtils.h"
+
+OutputWriter::OutputWriter() : m_busy(false), m_stop(false), m_num_written(0), m_num_unchanged(0)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+	Join();
+}
+
+// Files are written on a background thread so the compiler can go on encoding; at most MAX_QUEUED_OUTPUTS buffers wait at a time
+void OutputWriter::Write(std::string path, std::string data)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (!m_thread.joinable())
+	{
+		m_stop = false;
+		m_thread = std::thread(&OutputWriter::Run, this);
+	}
+
+	m_queue_changed.wait(lock, [this] { return m_queue.size() < MAX_QUEUED_OUTPUTS; });
+	m_queue.emplace_back(std::move(path), std::move(data));
+	m_queue_changed.notify_all();
+}
+
+void OutputWriter::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_queue_changed.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+}
+
+void OutputWriter::Join()
+{
+	if (!m_thread.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_stop = true;
+	}
+
+	m_queue_changed.notify_all();
+	m_thread.join();
+}
+
+void OutputWriter::Run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_queue_changed.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+
+		if (m_queue.empty()) return;
+
+		std::pair<std::string, std::string> output = std::move(m_queue.front());
+
+		m_queue.pop_front();
+		m_busy = true;
+		m_queue_changed.notify_all();
+		lock.unlock();
+
+		WriteFile(output.first, output.second);
+
+		lock.lock();
+		m_busy = false;
+		m_queue_changed.notify_all();
+	}
+}
+
+// Files whose contents did not change are left alone, others are written next to the target and renamed over it
+void OutputWriter::WriteFile(const std::string &path, std::string &data)
+{
+#if defined _WIN32
+	std::string text;
+
+	text.reserve(data.size() + std::count(data.begin(), data.end(), '\n'));
+
+	for (char c : data)
+	{
+		if (c == '\n') text.push_back('\r');
+
+		text.push_back(c);
+	}
+
+	data.swap(text);
+#endif
+
+	if (IsUnchanged(path, data))
+	{
+		m_num_unchanged++;
+		return;
+	}
+
+	std::error_code error = ReplaceFile(path, data);
+
+	if (error)
+		m_failures.emplace_back(path, error.message());
+	else
+		m_num_written++;
+}
+
+std::error_code OutputWriter::ReplaceFile(const std::string &path, std::string_view data)
+{
+#if defined _WIN32
+	static const std::string temp_suffix = "." + std::to_string(_getpid()) + ".tmp";
+#else
+	static const std::string temp_suffix = "." + std::to_string(getpid()) + ".tmp";
+#endif
+	std::string temp_path = path + temp_suffix;
+	std::ofstream stream(temp_path, std::ios::binary);
+	std::error_code error;
+
+	if (!stream.is_open())
+		error.assign(errno, std::generic_category());
+	else
+	{
+		stream.write(data.data(), data.size());
+		stream.close();
+
+		if (stream.fail())
+			error = std::make_error_code(std::errc::io_error);
+		else
+			std::filesystem::rename(temp_path, path, error);
+	}
+
+	if (error)
+	{
+		std::error_code remove_error;
+
+		std::filesystem::remove(temp_path, remove_error);
+	}
+
+	return error;
+}
+
+int OutputWriter::GetNumWritten() const
+{
+	return m_num_written;
+}
+
+int OutputWriter::GetNumUnchanged() const
+{
+	return m_num_unchanged;
+}
+
+int OutputWriter::GetNumFailed() const
+{
+	return (int)m_failures.size();
+}
+
+const std::vector<std::pair<std::string, std::string>> &OutputWriter::GetFailures() const
+{
+	return m_failures;
+}
+
+bool OutputWriter::IsUnchanged(const std::string &path, const std::string &data)
+{
+	std::error_code error;
+
+	if (std::filesystem::file_size(path, error) != data.size() || error) return false;
+
+	MappedFile file;
+
+	if (!file.Open(path)) return false;
+
+	return file.GetData() == data;
+}
+
+OutputBuffer::OutputBuffer(OutputWriter &writer) : m_writer(writer)
+{
+}
+
+OutputBuffer::OutputBuffer(const std::string &path, OutputWriter &writer) : m_writer(writer)
+{
+	Open(path);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+	Close();
+}
+
+void OutputBuffer::Open(const std::string &path)
+{
+	Close();
+	m_path = path;
+	m_data.reserve(1 << 16);
+}
+
+void OutputBuffer::Close()
+{
+	if (m_path.empty()) return;
+
+	m_writer.Write(std::move(m_path), std::move(m_data));
+	m_path.clear();
+	m_data.clear();
+}
+
+OutputBuffer &OutputBuffer::operator <<(char c)
+{
+	m_data.push_back(c);
+	return *this;
+}
+
+OutputBuffer &OutputBuffer::operator <<(const char *str)
+{
+	m_data.append(str);
+	return *this;
+}
+
+OutputBuffer &OutputBuffer::operator <<(std::string_view str)
+{
+	m_data.append(str.data(), str.size());
+	return *this;
+}
+
+OutputBuffer &OutputBuffer::operator <<(int value)
+{
+	return WriteInteger(value);
+}
+
+OutputBuffer &OutputBuffer::operator <<(unsigned int value)
+{
+	return WriteInteger(value);
+}
+
+OutputBuffer &OutputBuffer::operator <<(long value)
+{
+	return WriteInteger(value);
+}
+
+OutputBuffer &OutputBuffer::operator <<(unsigned long value)
+{
+	return WriteInteger(value);
+}
+
+OutputBuffer &OutputBuffer::operator <<(long long value)
+{
+	return WriteInteger(value);
+}
+
+OutputBuffer &OutputBuffer::operator <<(unsigned long long value)
+{
+	return WriteInteger(value);
+}
+
+OutputBuffer &OutputBuffer::operator <<(double value)
+{
+	char buffer[FLOAT_BUFFER_SIZE];
+
+	m_data.append(buffer, format_float(buffer, value));
+	return *this;
+}
+
+template <typename T> OutputBuffer &OutputBuffer::WriteInteger(T value)
+{
+	char buffer[24];
+	std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+
+	m_data.append(buffer, result.ptr - buffer);
+	return *this;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define MAX_QUEUED_OUTPUTS 8
+
+class OutputWriter
+{
+public:
+	OutputWriter();
+	OutputWriter(const OutputWriter &) = delete;
+	~OutputWriter();
+	void Write(std::string path, std::string data);
+	void Flush();
+	void Join();
+	int GetNumWritten() const;
+	int GetNumUnchanged() const;
+	int GetNumFailed() const;
+	const std::vector<std::pair<std::string, std::string>> &GetFailures() const;
+	static std::error_code ReplaceFile(const std::string &path, std::string_view data);
+	OutputWriter &operator =(const OutputWriter &) = delete;
+
+private:
+	void Run();
+	void WriteFile(const std::string &path, std::string &data);
+	static bool IsUnchanged(const std::string &path, const std::string &data);
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_queue_changed;
+	std::deque<std::pair<std::string, std::string>> m_queue;
+	bool m_busy;
+	bool m_stop;
+	int m_num_written;
+	int m_num_unchanged;
+	std::vector<std::pair<std::string, std::string>> m_failures;
+};
+
+class OutputBuffer
+{
+public:
+	explicit OutputBuffer(OutputWriter &writer);
+	OutputBuffer(const std::string &path, OutputWriter &writer);
+	OutputBuffer(const OutputBuffer &) = delete;
+	~OutputBuffer();
+	void Open(const std::string &path);
+	void Close();
+	OutputBuffer &operator <<(char c);
+	OutputBuffer &operator <<(const char *str);
+	OutputBuffer &operator <<(std::string_view str);
+	OutputBuffer &operator <<(int value);
+	OutputBuffer &operator <<(unsigned int value);
+	OutputBuffer &operator <<(long value);
+	OutputBuffer &operator <<(unsigned long value);
+	OutputBuffer &operator <<(long long value);
+	OutputBuffer &operator <<(unsigned long long value);
+	OutputBuffer &operator <<(double value);
+	OutputBuffer &operator =(const OutputBuffer &) = delete;
+
+private:
+	template <typename T> OutputBuffer &WriteInteger(T value);
+
+	OutputWriter &m_writer;
+	std::string m_path;
+	std::string m_data;
+};
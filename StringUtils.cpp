@@ -1,4 +1,17 @@
 #include "StringUtils.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined __AVX2__
+#define USE_AVX2
+#include <immintrin.h>
+#endif
 
 std::string &ltrim(std::string &str, const std::string &chars)
 {
@@ -61,3 +74,332 @@ std::string itostr(int number)
 	_itoa(number, buffer, 10);
 	return buffer;
 }
+
+size_t format_float(char *buffer, double value)
+{
+	char *pos = buffer;
+
+	if (std::isnan(value))
+	{
+		memcpy(buffer, "nan", 3);
+		return 3;
+	}
+
+	if (std::signbit(value))
+	{
+		*pos++ = '-';
+		value = -value;
+	}
+
+	if (std::isinf(value))
+	{
+		memcpy(pos, "inf", 3);
+		return pos + 3 - buffer;
+	}
+
+	// to_chars picks the shortest digit string, it only has to be rearranged into repr's layout
+	char digits[FLOAT_BUFFER_SIZE];
+	char *end = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::scientific).ptr;
+	char *exp_pos = std::find(digits, end, 'e');
+	int exponent = 0;
+	int num_digits = 0;
+
+	std::from_chars(exp_pos + (exp_pos[1] == '+' ? 2 : 1), end, exponent);
+
+	for (char *it = digits; it < exp_pos; ++it)
+	{
+		if (*it != '.') digits[num_digits++] = *it;
+	}
+
+	if (exponent < -4 || exponent >= 16)
+	{
+		*pos++ = digits[0];
+
+		if (num_digits > 1)
+		{
+			*pos++ = '.';
+			memcpy(pos, digits + 1, num_digits - 1);
+			pos += num_digits - 1;
+		}
+
+		*pos++ = 'e';
+		*pos++ = exponent < 0 ? '-' : '+';
+
+		if (exponent < 0) exponent = -exponent;
+		if (exponent < 10) *pos++ = '0';
+
+		return std::to_chars(pos, buffer + FLOAT_BUFFER_SIZE, exponent).ptr - buffer;
+	}
+
+	int num_int_digits = exponent + 1;
+
+	if (num_int_digits <= 0)
+	{
+		*pos++ = '0';
+		*pos++ = '.';
+		memset(pos, '0', -num_int_digits);
+		pos += -num_int_digits;
+		memcpy(pos, digits, num_digits);
+		pos += num_digits;
+	}
+	else if (num_int_digits < num_digits)
+	{
+		memcpy(pos, digits, num_int_digits);
+		pos += num_int_digits;
+		*pos++ = '.';
+		memcpy(pos, digits + num_int_digits, num_digits - num_int_digits);
+		pos += num_digits - num_int_digits;
+	}
+	else
+	{
+		memcpy(pos, digits, num_digits);
+		pos += num_digits;
+		memset(pos, '0', num_int_digits - num_digits);
+		pos += num_int_digits - num_digits;
+		*pos++ = '.';
+		*pos++ = '0';
+	}
+
+	return pos - buffer;
+}
+
+std::string ftostr(double value)
+{
+	char buffer[FLOAT_BUFFER_SIZE];
+
+	return std::string(buffer, format_float(buffer, value));
+}
+
+static inline uint64_t load_word(const char *data, size_t size)
+{
+	uint64_t word = 0;
+
+	memcpy(&word, data, size);
+	return word;
+}
+
+static inline uint64_t fold_word(uint64_t word)
+{
+	uint64_t low = word & 0x7F7F7F7F7F7F7F7FULL;
+	uint64_t above_a = low + 0x3F3F3F3F3F3F3F3FULL;
+	uint64_t above_z = low + 0x2525252525252525ULL;
+
+	return word | (((above_a ^ above_z) & ~word & 0x8080808080808080ULL) >> 2);
+}
+
+static inline uint64_t mix_word(uint64_t hash, uint64_t word)
+{
+	hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+	return hash ^ (hash >> 29);
+}
+
+#ifdef USE_SSE2
+static inline __m128i fold_sse2(__m128i chars)
+{
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+
+	return _mm_or_si128(chars, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+#ifdef USE_AVX2
+static inline __m256i fold_avx2(__m256i chars)
+{
+	__m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), chars));
+
+	return _mm256_or_si256(chars, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+#endif
+
+uint32_t hash_lower(std::string_view str, uint32_t seed)
+{
+	const char *data = str.data();
+	size_t size = str.size();
+	size_t i = 0;
+	uint64_t hash = mix_word(seed, size);
+
+#ifdef USE_AVX2
+	for (; i + 32 <= size; i += 32)
+	{
+		uint64_t words[4];
+
+		_mm256_storeu_si256((__m256i *)words, fold_avx2(_mm256_loadu_si256((const __m256i *)(data + i))));
+
+		for (uint64_t word : words) hash = mix_word(hash, word);
+	}
+#endif
+#ifdef USE_SSE2
+	for (; i + 16 <= size; i += 16)
+	{
+		uint64_t words[2];
+
+		_mm_storeu_si128((__m128i *)words, fold_sse2(_mm_loadu_si128((const __m128i *)(data + i))));
+		hash = mix_word(mix_word(hash, words[0]), words[1]);
+	}
+#endif
+	for (; i + 8 <= size; i += 8) hash = mix_word(hash, fold_word(load_word(data + i, 8)));
+
+	if (i < size) hash = mix_word(hash, fold_word(load_word(data + i, size - i)));
+
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+bool equals_lower(std::string_view lower_str, std::string_view str)
+{
+	size_t size = str.size();
+	size_t i = 0;
+
+	if (lower_str.size() != size) return false;
+
+#ifdef USE_AVX2
+	for (; i + 32 <= size; i += 32)
+	{
+		__m256i chars = fold_avx2(_mm256_loadu_si256((const __m256i *)(str.data() + i)));
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_loadu_si256((const __m256i *)(lower_str.data() + i)))) != -1) return false;
+	}
+#endif
+#ifdef USE_SSE2
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i chars = fold_sse2(_mm_loadu_si128((const __m128i *)(str.data() + i)));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_loadu_si128((const __m128i *)(lower_str.data() + i)))) != 0xFFFF) return false;
+	}
+#endif
+	for (; i + 8 <= size; i += 8)
+	{
+		if (fold_word(load_word(str.data() + i, 8)) != load_word(lower_str.data() + i, 8)) return false;
+	}
+
+	return i == size || fold_word(load_word(str.data() + i, size - i)) == load_word(lower_str.data() + i, size - i);
+}
+
+struct EncodeTable
+{
+	char chars[256];
+	unsigned char keep[256];
+};
+
+static constexpr EncodeTable make_encode_table(int encoding)
+{
+	EncodeTable table = {};
+
+	for (int c = 0; c < 256; ++c)
+	{
+		table.chars[c] = (char)c;
+		table.keep[c] = 1;
+
+		if (encoding & ENC_LOWER && c >= 'A' && c <= 'Z') table.chars[c] = (char)(c + 0x20);
+	}
+
+	table.chars[' '] = table.chars['\t'] = '_';
+
+	if (encoding & ENC_FULL)
+	{
+		table.keep[','] = table.keep['|'] = 0;
+		table.chars['\''] = table.chars['`'] = table.chars['('] = table.chars[')'] = table.chars['-'] = '_';
+	}
+
+	return table;
+}
+
+static constexpr EncodeTable encode_tables[] = {
+	make_encode_table(0),
+	make_encode_table(ENC_FULL),
+	make_encode_table(ENC_LOWER),
+	make_encode_table(ENC_FULL | ENC_LOWER),
+};
+
+static inline char *encode_table(char *out, const char *data, size_t size, const EncodeTable &table)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		unsigned char c = data[i];
+
+		*out = table.chars[c];
+		out += table.keep[c];
+	}
+
+	return out;
+}
+
+// Vector paths rewrite whole blocks in registers and leave blocks with dropped characters to the table
+#ifdef USE_SSE2
+static inline bool encode_sse2(char *out, const char *data, int encoding)
+{
+	__m128i chars = _mm_loadu_si128((const __m128i *)data);
+	__m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')));
+
+	if (encoding & ENC_FULL)
+	{
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(',')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('|'))))) return false;
+
+		blank = _mm_or_si128(blank, _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\'')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('`'))));
+		blank = _mm_or_si128(blank, _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('(')), _mm_cmpeq_epi8(chars, _mm_set1_epi8(')'))));
+		blank = _mm_or_si128(blank, _mm_cmpeq_epi8(chars, _mm_set1_epi8('-')));
+	}
+
+	if (encoding & ENC_LOWER) chars = fold_sse2(chars);
+
+	_mm_storeu_si128((__m128i *)out, _mm_or_si128(_mm_andnot_si128(blank, chars), _mm_and_si128(blank, _mm_set1_epi8('_'))));
+	return true;
+}
+#endif
+
+#ifdef USE_AVX2
+static inline bool encode_avx2(char *out, const char *data, int encoding)
+{
+	__m256i chars = _mm256_loadu_si256((const __m256i *)data);
+	__m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t')));
+
+	if (encoding & ENC_FULL)
+	{
+		if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(',')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('|'))))) return false;
+
+		blank = _mm256_or_si256(blank, _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\'')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('`'))));
+		blank = _mm256_or_si256(blank, _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('(')), _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(')'))));
+		blank = _mm256_or_si256(blank, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('-')));
+	}
+
+	if (encoding & ENC_LOWER) chars = fold_avx2(chars);
+
+	_mm256_storeu_si256((__m256i *)out, _mm256_blendv_epi8(chars, _mm256_set1_epi8('_'), blank));
+	return true;
+}
+#endif
+
+size_t encode_chars(char *out, std::string_view str, int encoding)
+{
+	// Like trim(), a string made only of whitespace is left as it is
+	size_t first = encoding & ENC_TRIM ? str.find_first_not_of(" \t\n\v\f\r") : std::string_view::npos;
+
+	if (first != std::string_view::npos) str = str.substr(first, str.find_last_not_of(" \t\n\v\f\r") - first + 1);
+
+	const EncodeTable &table = encode_tables[encoding & (ENC_FULL | ENC_LOWER)];
+	const char *data = str.data();
+	size_t size = str.size();
+	size_t i = 0;
+	char *pos = out;
+
+#ifdef USE_AVX2
+	for (; i + 32 <= size; i += 32)
+	{
+		if (encode_avx2(pos, data + i, encoding))
+			pos += 32;
+		else
+			pos = encode_table(pos, data + i, 32, table);
+	}
+#endif
+#ifdef USE_SSE2
+	for (; i + 16 <= size; i += 16)
+	{
+		if (encode_sse2(pos, data + i, encoding))
+			pos += 16;
+		else
+			pos = encode_table(pos, data + i, 16, table);
+	}
+#endif
+
+	return encode_table(pos, data + i, size - i, table) - out;
+}
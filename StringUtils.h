@@ -1,8 +1,16 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <sstream>
 #include <string>
+#include <string_view>
+
+#define FLOAT_BUFFER_SIZE 32
+
+#define ENC_FULL  0x1
+#define ENC_LOWER 0x2
+#define ENC_TRIM  0x4
 
 std::string &ltrim(std::string &str, const std::string &chars = " \t\n\v\f\r");
 std::string &rtrim(std::string &str, const std::string &chars = " \t\n\v\f\r");
@@ -11,3 +19,11 @@ std::string &lower(std::string &str);
 std::string &replace(std::string &str, char character, char replacement);
 std::string &remove(std::string &str, char character);
 std::string itostr(int number);
+// Shortest digits that round-trip, laid out the way Python's repr(float) does; buffer needs FLOAT_BUFFER_SIZE chars
+size_t format_float(char *buffer, double value);
+std::string ftostr(double value);
+// ASCII case-insensitive hash and comparison without a lowercase copy; lower_str must already be lowercase
+uint32_t hash_lower(std::string_view str, uint32_t seed = 0);
+bool equals_lower(std::string_view lower_str, std::string_view str);
+// Module system name encoding in one pass; out needs room for str.size() chars and never receives more
+size_t encode_chars(char *out, std::string_view str, int encoding);
@@ -0,0 +1,172 @@
+#include "SymbolTable.h"
+#include <algorithm>
+#include <cctype>
+#include "StringUtils.h"
+
+SymbolTable::SymbolTable() : m_arena(1 << 16), m_slots(1024, -1)
+{
+}
+
+int SymbolTable::AddPrefix(std::string_view prefix, bool known)
+{
+	int index = FindPrefix(prefix);
+
+	if (index < 0)
+	{
+		index = (int)m_prefixes.size();
+		m_prefixes.push_back(StoreLower(prefix));
+		m_tags.push_back(0);
+		m_known.push_back(0);
+		m_uses.emplace_back();
+		m_entities.emplace_back();
+	}
+
+	if (known) m_known[index] = 1;
+
+	return index;
+}
+
+int SymbolTable::FindPrefix(std::string_view prefix) const
+{
+	for (size_t i = 0; i < m_prefixes.size(); ++i)
+	{
+		if (equals_lower(m_prefixes[i], prefix)) return m_known[i] ? (int)i : -1;
+	}
+
+	return -1;
+}
+
+bool SymbolTable::IsKnown(int prefix) const
+{
+	return m_known[prefix] != 0;
+}
+
+void SymbolTable::SetKnown(int prefix)
+{
+	m_known[prefix] = 1;
+}
+
+int SymbolTable::GetNumPrefixes() const
+{
+	return (int)m_prefixes.size();
+}
+
+std::string_view SymbolTable::GetPrefix(int prefix) const
+{
+	return m_prefixes[prefix];
+}
+
+void SymbolTable::SetTag(int prefix, unsigned long long tag)
+{
+	m_tags[prefix] = tag;
+}
+
+unsigned long long SymbolTable::GetTag(int prefix) const
+{
+	return m_tags[prefix];
+}
+
+int SymbolTable::Add(int prefix, std::string_view name, int id, bool tracked)
+{
+	uint32_t hash = Hash(prefix, name);
+	int slot = FindSlot(prefix, name, hash);
+
+	if (m_slots[slot] >= 0) return m_slots[slot];
+
+	int symbol = (int)m_ids.size();
+
+	m_slots[slot] = symbol;
+	m_hashes.push_back(hash);
+	m_symbol_prefixes.push_back(prefix);
+	m_names.push_back(StoreLower(name));
+	m_ids.push_back(id);
+	m_tracked.push_back(tracked);
+
+	if (tracked)
+	{
+		if (m_entities[prefix].size() <= (size_t)id)
+		{
+			m_entities[prefix].resize(id + 1, -1);
+			m_uses[prefix].resize(id + 1, 0);
+		}
+
+		m_entities[prefix][id] = symbol;
+	}
+
+	if (m_ids.size() * 2 > m_slots.size()) Grow();
+
+	return symbol;
+}
+
+int SymbolTable::Find(int prefix, std::string_view name) const
+{
+	return m_slots[FindSlot(prefix, name, Hash(prefix, name))];
+}
+
+int SymbolTable::GetId(int symbol) const
+{
+	return m_ids[symbol];
+}
+
+void SymbolTable::AddUse(int symbol)
+{
+	if (m_tracked[symbol]) m_uses[m_symbol_prefixes[symbol]][m_ids[symbol]]++;
+}
+
+std::vector<std::string_view> SymbolTable::GetUnused(int prefix) const
+{
+	std::vector<std::string_view> names;
+
+	const std::vector<uint32_t> &uses = m_uses[prefix];
+	const std::vector<int> &entities = m_entities[prefix];
+
+	for (size_t i = 0; i < uses.size(); ++i)
+	{
+		if (!uses[i] && entities[i] >= 0) names.push_back(m_names[entities[i]]);
+	}
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+uint32_t SymbolTable::Hash(int prefix, std::string_view name)
+{
+	return hash_lower(name, (uint32_t)prefix);
+}
+
+int SymbolTable::FindSlot(int prefix, std::string_view name, uint32_t hash) const
+{
+	size_t mask = m_slots.size() - 1;
+
+	for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+	{
+		int symbol = m_slots[slot];
+
+		if (symbol < 0 || (m_hashes[symbol] == hash && m_symbol_prefixes[symbol] == prefix && equals_lower(m_names[symbol], name))) return (int)slot;
+	}
+}
+
+std::string_view SymbolTable::StoreLower(std::string_view str)
+{
+	char *data = m_arena.Allocate<char>(str.size());
+
+	std::transform(str.begin(), str.end(), data, ::tolower);
+	return std::string_view(data, str.size());
+}
+
+void SymbolTable::Grow()
+{
+	std::vector<int> slots(m_slots.size() * 2, -1);
+	size_t mask = slots.size() - 1;
+
+	for (size_t i = 0; i < m_hashes.size(); ++i)
+	{
+		size_t slot = m_hashes[i] & mask;
+
+		while (slots[slot] >= 0) slot = (slot + 1) & mask;
+
+		slots[slot] = (int)i;
+	}
+
+	m_slots.swap(slots);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Arena.h"
+
+class SymbolTable
+{
+public:
+	SymbolTable();
+	int AddPrefix(std::string_view prefix, bool known = true);
+	int FindPrefix(std::string_view prefix) const;
+	bool IsKnown(int prefix) const;
+	void SetKnown(int prefix);
+	int GetNumPrefixes() const;
+	std::string_view GetPrefix(int prefix) const;
+	void SetTag(int prefix, unsigned long long tag);
+	unsigned long long GetTag(int prefix) const;
+	int Add(int prefix, std::string_view name, int id, bool tracked = true);
+	int Find(int prefix, std::string_view name) const;
+	int GetId(int symbol) const;
+	void AddUse(int symbol);
+	std::vector<std::string_view> GetUnused(int prefix) const;
+
+private:
+	static uint32_t Hash(int prefix, std::string_view name);
+	int FindSlot(int prefix, std::string_view name, uint32_t hash) const;
+	std::string_view StoreLower(std::string_view str);
+	void Grow();
+
+	Arena m_arena;
+	std::vector<std::string_view> m_prefixes;
+	std::vector<unsigned long long> m_tags;
+	std::vector<char> m_known;
+	std::vector<std::vector<uint32_t>> m_uses;
+	std::vector<std::vector<int>> m_entities;
+	std::vector<int> m_slots;
+	std::vector<uint32_t> m_hashes;
+	std::vector<int> m_symbol_prefixes;
+	std::vector<std::string_view> m_names;
+	std::vector<int> m_ids;
+	std::vector<char> m_tracked;
+};
@@ -0,0 +1,187 @@
+#include "WideInt.h"
+#include <algorithm>
+
+WideInt::WideInt() : m_negative(false)
+{
+	std::fill(m_words, m_words + NUM_WORDS, 0ULL);
+}
+
+WideInt::WideInt(long long val) : m_negative(val < 0)
+{
+	m_words[0] = (unsigned long long)val;
+	std::fill(m_words + 1, m_words + NUM_WORDS, m_negative ? ~0ULL : 0ULL);
+}
+
+// Little-endian two's complement bytes; the sign is taken from the last byte and extends past the top word
+WideInt::WideInt(const unsigned char *bytes, size_t size) : m_negative(size && (bytes[size - 1] & 0x80))
+{
+	unsigned long long fill = m_negative ? ~0ULL : 0ULL;
+
+	std::fill(m_words, m_words + NUM_WORDS, fill);
+
+	for (size_t i = 0; i < size && i < NUM_WORDS * 8; ++i)
+	{
+		unsigned long long &word = m_words[i / 8];
+		int shift = (int)(i % 8) * 8;
+
+		word = (word & ~(0xFFULL << shift)) | ((unsigned long long)bytes[i] << shift);
+	}
+}
+
+WideInt WideInt::operator >>(int shift) const
+{
+	WideInt result;
+	unsigned long long fill = m_negative ? ~0ULL : 0ULL;
+
+	if (shift <= 0) return shift == 0 ? *this : *this << -shift;
+
+	result.m_negative = m_negative;
+
+	if (shift >= NUM_BITS)
+	{
+		std::fill(result.m_words, result.m_words + NUM_WORDS, fill);
+		return result;
+	}
+
+	int word_shift = shift / 64;
+	int bit_shift = shift % 64;
+
+	for (int i = 0; i < NUM_WORDS; ++i)
+	{
+		int src = i + word_shift;
+		unsigned long long lo = src < NUM_WORDS ? m_words[src] : fill;
+		unsigned long long hi = src + 1 < NUM_WORDS ? m_words[src + 1] : fill;
+
+		result.m_words[i] = bit_shift ? (lo >> bit_shift) | (hi << (64 - bit_shift)) : lo;
+	}
+
+	return result;
+}
+
+WideInt WideInt::operator <<(int shift) const
+{
+	WideInt result;
+
+	if (shift <= 0) return shift == 0 ? *this : *this >> -shift;
+
+	result.m_negative = m_negative;
+
+	if (shift >= NUM_BITS) return result;
+
+	int word_shift = shift / 64;
+	int bit_shift = shift % 64;
+
+	for (int i = NUM_WORDS - 1; i >= word_shift; --i)
+	{
+		int src = i - word_shift;
+		unsigned long long hi = m_words[src];
+		unsigned long long lo = src > 0 ? m_words[src - 1] : 0ULL;
+
+		result.m_words[i] = bit_shift ? (hi << bit_shift) | (lo >> (64 - bit_shift)) : hi;
+	}
+
+	return result;
+}
+
+unsigned long long WideInt::operator &(unsigned long long mask) const
+{
+	return m_words[0] & mask;
+}
+
+bool WideInt::operator ==(const WideInt &val) const
+{
+	return m_negative == val.m_negative && std::equal(m_words, m_words + NUM_WORDS, val.m_words);
+}
+
+bool WideInt::operator !=(const WideInt &val) const
+{
+	return !(*this == val);
+}
+
+unsigned long long WideInt::Bits(int shift, int count) const
+{
+	unsigned long long bits = (*this >> shift).Low();
+
+	return count >= 64 ? bits : bits & ((1ULL << count) - 1);
+}
+
+unsigned long long WideInt::Low() const
+{
+	return m_words[0];
+}
+
+bool WideInt::IsNegative() const
+{
+	return m_negative;
+}
+
+bool WideInt::IsZero() const
+{
+	return !m_negative && std::all_of(m_words, m_words + NUM_WORDS, [](unsigned long long word) { return word == 0; });
+}
+
+std::string WideInt::ToString() const
+{
+	unsigned int limbs[NUM_WORDS * 2];
+	bool negative = IsNegative();
+	unsigned long long carry = 1;
+
+	for (int i = 0; i < NUM_WORDS; ++i)
+	{
+		unsigned long long word = m_words[i];
+
+		if (negative)
+		{
+			word = ~word + carry;
+			carry = carry && word == 0;
+		}
+
+		limbs[i * 2] = (unsigned int)word;
+		limbs[i * 2 + 1] = (unsigned int)(word >> 32);
+	}
+
+	char buffer[NUM_BITS / 3 + 3];
+	char *pos = buffer + sizeof(buffer);
+	int num_limbs = NUM_WORDS * 2;
+
+	while (num_limbs > 0 && limbs[num_limbs - 1] == 0) num_limbs--;
+
+	do
+	{
+		unsigned long long rem = 0;
+
+		for (int i = num_limbs - 1; i >= 0; --i)
+		{
+			unsigned long long cur = (rem << 32) | limbs[i];
+
+			limbs[i] = (unsigned int)(cur / 1000000000);
+			rem = cur % 1000000000;
+		}
+
+		while (num_limbs > 0 && limbs[num_limbs - 1] == 0) num_limbs--;
+
+		for (int i = 0; i < 9 && (num_limbs > 0 || rem != 0 || i == 0); ++i)
+		{
+			*--pos = (char)('0' + rem % 10);
+			rem /= 10;
+		}
+	} while (num_limbs > 0);
+
+	if (negative) *--pos = '-';
+
+	return std::string(pos, buffer + sizeof(buffer) - pos);
+}
+
+std::ostream &operator <<(std::ostream &stream, const WideInt &val)
+{
+	if (!val.m_negative && val.m_words[1] == 0 && val.m_words[2] == 0 && val.m_words[3] == 0) return stream << val.m_words[0];
+
+	return stream << val.ToString();
+}
+
+OutputBuffer &operator <<(OutputBuffer &stream, const WideInt &val)
+{
+	if (!val.m_negative && val.m_words[1] == 0 && val.m_words[2] == 0 && val.m_words[3] == 0) return stream << val.m_words[0];
+
+	return stream << val.ToString();
+}
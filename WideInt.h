@@ -0,0 +1,32 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include "OutputBuffer.h"
+
+class WideInt
+{
+public:
+	static const int NUM_WORDS = 4;
+	static const int NUM_BITS = NUM_WORDS * 64;
+
+	WideInt();
+	WideInt(long long val);
+	WideInt(const unsigned char *bytes, size_t size);
+	WideInt operator >>(int shift) const;
+	WideInt operator <<(int shift) const;
+	unsigned long long operator &(unsigned long long mask) const;
+	bool operator ==(const WideInt &val) const;
+	bool operator !=(const WideInt &val) const;
+	unsigned long long Bits(int shift, int count) const;
+	unsigned long long Low() const;
+	bool IsNegative() const;
+	bool IsZero() const;
+	std::string ToString() const;
+	friend std::ostream &operator <<(std::ostream &stream, const WideInt &val);
+	friend OutputBuffer &operator <<(OutputBuffer &stream, const WideInt &val);
+
+private:
+	unsigned long long m_words[NUM_WORDS];
+	bool m_negative;
+};
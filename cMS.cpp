@@ -30,8 +30,15 @@ int main(int argc, char **argv)
 	if (opt.Has("-hide-tags")) flags |= MSF_OBFUSCATE_TAGS;
 	if (opt.Has("-compile-data")) flags |= MSF_COMPILE_MODULE_DATA;
 	if (opt.Has("-list-unreferenced-scripts")) flags |= MSF_LIST_UNREFERENCED_SCRIPTS;
+	if (opt.Has("-list-unreferenced")) flags |= MSF_LIST_UNREFERENCED;
+	if (opt.Has("-stats")) flags |= MSF_STATISTICS;
 	if (opt.Has("-no-warnings")) flags |= MSF_DISABLE_WARNINGS;
 	if (opt.Has("-rusmod_rebalanser")) flags |= MSF_RUSMOD_REBALANSER;
+	if (opt.Has("-single-interpreter")) flags |= MSF_SINGLE_INTERPRETER;
+	if (opt.Has("-isolated-python")) flags |= MSF_ISOLATED_PYTHON;
+	if (opt.Has("-parallel-import")) flags |= MSF_PARALLEL_IMPORT;
+	if (opt.Has("-bytecode-cache")) flags |= MSF_BYTECODE_CACHE;
+	if (opt.Has("-prewarm")) flags |= MSF_PREWARM;
 
 	std::string in_path;
 
@@ -56,6 +63,10 @@ int main(int argc, char **argv)
 
 	if (opt.Has("-out-path")) out_path = opt.Get("-out-path");
 
+	std::string cache_path;
+
+	if (opt.Has("-cache-dir")) cache_path = opt.Get("-cache-dir");
+
 	auto leftover = opt.Leftover();
 
 	for (auto & it : leftover) std::cout << "Unrecognized option: " << it << std::endl;
@@ -64,6 +75,6 @@ int main(int argc, char **argv)
 
 	ModuleSystem ms(in_path, out_path);
 
-	ms.Compile(flags);
-	return EXIT_SUCCESS;
+	ms.SetCachePath(cache_path);
+	return ms.Compile(flags) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,5 +1,5 @@
 #!/bin/bash
 CFLAGS=$(python3-config --includes)
 LDFLAGS=$(python3-config --ldflags)
-g++ -std=c++14 -O2 -Wall cMS.cpp StringUtils.cpp ModuleSystem.cpp CPyObject.cpp OptUtils.cpp -o ms-pp-linux $CFLAGS $LDFLAGS 
+g++ -std=c++17 -O2 -Wall cMS.cpp StringUtils.cpp ModuleSystem.cpp CPyObject.cpp OptUtils.cpp WideInt.cpp Arena.cpp ModuleData.cpp SymbolTable.cpp MappedFile.cpp OperationTable.cpp AllocationCounter.cpp OutputBuffer.cpp -o ms-pp-linux $CFLAGS $LDFLAGS 
 chmod 755 ms-pp-linux